@@ -3,6 +3,8 @@
 #include "PhysicsEngine.h"
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <limits>
 
 namespace PhysicsEngine
 {
@@ -90,6 +92,303 @@ namespace PhysicsEngine
 	};
 
 
+	///The ConvexMesh class
+	class ConvexMesh : public DynamicActor
+	{
+	public:
+		//constructor
+		ConvexMesh(const std::vector<PxVec3>& verts, const PxTransform& pose=PxTransform(PxIdentity), PxReal density=1.f)
+			: DynamicActor(pose)
+		{
+			PxConvexMeshDesc mesh_desc;
+			mesh_desc.points.count = (PxU32)verts.size();
+			mesh_desc.points.stride = sizeof(PxVec3);
+			mesh_desc.points.data = &verts.front();
+			mesh_desc.flags = PxConvexFlag::eCOMPUTE_CONVEX;
+			mesh_desc.vertexLimit = 256;
+
+			//cooked streams are cached on disk, unchanged meshes load without cooking
+			PxConvexMesh* mesh = CookConvexMesh(mesh_desc);
+			CreateShape(PxConvexMeshGeometry(mesh), density);
+			//the shape keeps its own reference to the mesh, ours is released
+			mesh->release();
+		}
+	};
+
+	///The TriangleMesh class
+	class TriangleMesh : public StaticActor
+	{
+	public:
+		//constructor
+		TriangleMesh(const std::vector<PxVec3>& verts, const std::vector<PxU32>& trigs, const PxTransform& pose=PxTransform(PxIdentity))
+			: StaticActor(pose)
+		{
+			PxTriangleMeshDesc mesh_desc;
+			mesh_desc.points.count = (PxU32)verts.size();
+			mesh_desc.points.stride = sizeof(PxVec3);
+			mesh_desc.points.data = &verts.front();
+			mesh_desc.triangles.count = (PxU32)trigs.size()/3;
+			mesh_desc.triangles.stride = 3*sizeof(PxU32);
+			mesh_desc.triangles.data = &trigs.front();
+
+			//cooked streams are cached on disk, unchanged meshes load without cooking
+			PxTriangleMesh* mesh = CookTriangleMesh(mesh_desc);
+			CreateShape(PxTriangleMeshGeometry(mesh));
+			//the shape keeps its own reference to the mesh, ours is released
+			mesh->release();
+		}
+	};
+
+	///HeightField class
+	class HeightField : public StaticActor
+	{
+	public:
+		//a heightfield from a row-major array of heights (in metres):
+		// - rows run along the X axis, columns along the Z axis
+		// - spacing: distance between samples along X and Z
+		HeightField(const std::vector<PxReal>& heights, PxU32 rows, PxU32 columns, const PxTransform& pose = PxTransform(PxIdentity),
+			PxVec2 spacing = PxVec2(1.f, 1.f))
+			: StaticActor(pose)
+		{
+			CreateHeightFieldShape(CreateGeometry(heights, rows, columns, spacing));
+		}
+
+		//a heightfield from a greyscale image (binary PGM), white samples are max_height metres high
+		HeightField(const std::string& filename, const PxTransform& pose = PxTransform(PxIdentity), PxReal max_height = 1.f,
+			PxVec2 spacing = PxVec2(1.f, 1.f))
+			: StaticActor(pose)
+		{
+			std::vector<PxReal> heights;
+			PxU32 rows, columns;
+			LoadPGM(filename, max_height, heights, rows, columns);
+			CreateHeightFieldShape(CreateGeometry(heights, rows, columns, spacing));
+		}
+
+		//the shape keeps its own reference to the heightfield, ours is released
+		void CreateHeightFieldShape(const PxHeightFieldGeometry& geometry)
+		{
+			CreateShape(geometry);
+			geometry.heightField->release();
+		}
+
+		//heightfield preparation: heights are quantised to 16 bit samples
+		PxHeightFieldGeometry CreateGeometry(const std::vector<PxReal>& heights, PxU32 rows, PxU32 columns, PxVec2 spacing)
+		{
+			if ((rows < 2) || (columns < 2) || (heights.size() < rows*columns))
+				throw new Exception("HeightField::CreateGeometry, not enough samples.");
+
+			PxReal max_height = 0.f;
+			for (PxU32 i = 0; i < rows*columns; i++)
+				max_height = PxMax(max_height, PxAbs(heights[i]));
+			PxReal height_scale = (max_height > 0.f) ? max_height / 32767.f : 1.f;
+
+			std::vector<PxHeightFieldSample> samples(rows*columns);
+			for (PxU32 i = 0; i < rows*columns; i++)
+			{
+				samples[i].height = (PxI16)(heights[i] / height_scale);
+				samples[i].materialIndex0 = 0;
+				samples[i].materialIndex1 = 0;
+				samples[i].clearTessFlag();
+			}
+
+			PxHeightFieldDesc desc;
+			desc.format = PxHeightFieldFormat::eS16_TM;
+			desc.nbRows = rows;
+			desc.nbColumns = columns;
+			desc.samples.data = &samples.front();
+			desc.samples.stride = sizeof(PxHeightFieldSample);
+
+			PxHeightField* height_field = GetPhysics()->createHeightField(desc);
+			if (!height_field)
+				throw new Exception("HeightField::CreateGeometry, could not create the heightfield.");
+
+			return PxHeightFieldGeometry(height_field, PxMeshGeometryFlags(), height_scale, spacing.x, spacing.y);
+		}
+
+		//skip white space and '#' comment lines between the fields of a PGM header
+		static void SkipPGMComments(std::istream& file)
+		{
+			file >> std::ws;
+			while (file.peek() == '#')
+			{
+				file.ignore((std::numeric_limits<std::streamsize>::max)(), '\n');
+				file >> std::ws;
+			}
+		}
+
+		//load a binary PGM (P5) image, 8 or 16 bit
+		void LoadPGM(const std::string& filename, PxReal max_height, std::vector<PxReal>& heights, PxU32& rows, PxU32& columns)
+		{
+			std::ifstream file(filename.c_str(), std::ios::binary);
+			std::string magic;
+			PxU32 max_value = 0;
+
+			file >> magic;
+			SkipPGMComments(file);
+			file >> columns;
+			SkipPGMComments(file);
+			file >> rows;
+			SkipPGMComments(file);
+			file >> max_value;
+			if (!file || (magic != "P5") || !max_value || (max_value > 65535))
+				throw new Exception("HeightField::LoadPGM, " + filename + " is not a binary PGM image.");
+			file.get();
+
+			PxU32 bytes = (max_value < 256) ? 1 : 2;
+			std::vector<unsigned char> pixels(rows*columns*bytes);
+			file.read((char*)&pixels.front(), pixels.size());
+			if (!file)
+				throw new Exception("HeightField::LoadPGM, " + filename + " is truncated.");
+
+			//image rows map to heightfield rows
+			heights.resize(rows*columns);
+			for (PxU32 i = 0; i < rows*columns; i++)
+			{
+				PxU32 value = (bytes == 1) ? pixels[i] : ((pixels[2*i] << 8) | pixels[2*i+1]);
+				heights[i] = max_height * value / max_value;
+			}
+		}
+	};
+
+	///Cloth class
+	class Cloth : public Actor
+	{
+		PxClothMeshDesc mesh_desc;
+		std::vector<PxClothParticle> vertices;
+		std::vector<PxU32> quads;
+
+	public:
+		//a grid cloth in the XZ plane of the pose:
+		// - size: dimensions along X and Z
+		// - width, height: number of quads along X and Z
+		// - fix_top: pin the first row of particles in place
+		Cloth(const PxTransform& pose = PxTransform(PxIdentity), const PxVec2& size = PxVec2(1.f, 1.f), PxU32 width = 1, PxU32 height = 1, bool fix_top = true)
+		{
+			//prepare vertices
+			PxReal w_step = size.x / width;
+			PxReal h_step = size.y / height;
+
+			vertices.resize((width+1)*(height+1));
+			quads.resize(width*height*4);
+
+			for (PxU32 j = 0; j < (height+1); j++)
+			{
+				for (PxU32 i = 0; i < (width+1); i++)
+				{
+					PxU32 offset = i + j*(width+1);
+					vertices[offset].pos = PxVec3(w_step*i, 0.f, h_step*j);
+					//fix the top row of vertices
+					vertices[offset].invWeight = (fix_top && (j == 0)) ? 0.f : 1.f;
+				}
+			}
+
+			for (PxU32 j = 0; j < height; j++)
+			{
+				for (PxU32 i = 0; i < width; i++)
+				{
+					PxU32 offset = (i + j*width)*4;
+					quads[offset + 0] = (i+0) + (j+0)*(width+1);
+					quads[offset + 1] = (i+1) + (j+0)*(width+1);
+					quads[offset + 2] = (i+1) + (j+1)*(width+1);
+					quads[offset + 3] = (i+0) + (j+1)*(width+1);
+				}
+			}
+
+			//init cloth mesh description
+			mesh_desc.points.data = &vertices.front().pos;
+			mesh_desc.points.count = (PxU32)vertices.size();
+			mesh_desc.points.stride = sizeof(PxClothParticle);
+
+			mesh_desc.invMasses.data = &vertices.front().invWeight;
+			mesh_desc.invMasses.count = (PxU32)vertices.size();
+			mesh_desc.invMasses.stride = sizeof(PxClothParticle);
+
+			mesh_desc.quads.data = &quads.front();
+			mesh_desc.quads.count = width*height;
+			mesh_desc.quads.stride = sizeof(PxU32)*4;
+
+			//create cloth fabric (cooking)
+			PxClothFabric* fabric = PxClothFabricCreate(*GetPhysics(), mesh_desc, PxVec3(0.f, -1.f, 0.f));
+			if (!fabric)
+				throw new Exception("Cloth::Cloth, could not create the cloth fabric.");
+
+			//create cloth
+			actor = (PxActor*)GetPhysics()->createCloth(pose, *fabric, &vertices.front(), PxClothFlags());
+			if (!actor)
+				throw new Exception("Cloth::Cloth, could not create the cloth.");
+
+			//collisions with the scene objects
+			((PxCloth*)actor)->setClothFlag(PxClothFlag::eSCENE_COLLISION, true);
+
+			//pass the color and the mesh to the renderer
+			actor->userData = RenderTable::Attach(RenderTable::Get().Create(default_color, &mesh_desc));
+		}
+
+		~Cloth()
+		{
+			PxScene* px_scene = actor->getScene();
+			if (px_scene && px_scene->userData)
+				((Scene*)px_scene->userData)->Forget(this);
+
+			RenderTable::Get().Release(RenderTable::Row(actor->userData));
+			actor->release();
+		}
+
+		///Solver iterations per second: the main cost/quality trade-off of a cloth
+		void SolverFrequency(PxReal value)
+		{
+			((PxCloth*)actor)->setSolverFrequency(value);
+		}
+
+		PxReal SolverFrequency()
+		{
+			return ((PxCloth*)actor)->getSolverFrequency();
+		}
+
+		///How often the stiffness values are applied per second
+		void StiffnessFrequency(PxReal value)
+		{
+			((PxCloth*)actor)->setStiffnessFrequency(value);
+		}
+
+		PxReal StiffnessFrequency()
+		{
+			return ((PxCloth*)actor)->getStiffnessFrequency();
+		}
+
+		///Spheres (in the cloth's local space) that the particles collide with, 32 at most
+		void CollisionSpheres(const std::vector<PxClothCollisionSphere>& spheres)
+		{
+			if (spheres.size())
+				((PxCloth*)actor)->setCollisionSpheres(&spheres.front(), (PxU32)spheres.size());
+			else
+				((PxCloth*)actor)->setCollisionSpheres(0, 0);
+		}
+
+		///Join two collision spheres into a capsule
+		void AddCollisionCapsule(PxU32 first_sphere, PxU32 second_sphere)
+		{
+			((PxCloth*)actor)->addCollisionCapsule(first_sphere, second_sphere);
+		}
+
+		///The cloth goes to sleep when all particles are slower than this
+		void SleepThreshold(PxReal value)
+		{
+			((PxCloth*)actor)->setSleepLinearVelocity(value);
+		}
+
+		PxReal SleepThreshold()
+		{
+			return ((PxCloth*)actor)->getSleepLinearVelocity();
+		}
+
+		///Set the time (in seconds) before the cloth can go to sleep
+		void WakeCounter(PxReal value)
+		{
+			((PxCloth*)actor)->setWakeCounter(value);
+		}
+	};
+
 	//Distance joint with the springs switched on
 	class DistanceJoint : public Joint
 	{
@@ -0,0 +1,304 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include "Benchmarks.h"
+#include "MyPhysicsEngine.h"
+
+namespace Benchmarks
+{
+	using namespace std;
+	using namespace PhysicsEngine;
+
+	//time step and number of steps used by all benchmarks
+	static const PxReal time_step = 1.f/60.f;
+	static const PxU32 warmup_steps = 60;
+	static const PxU32 timed_steps = 300;
+
+	///Average time (in ms) of a single simulation step
+	static double TimeSteps(Scene* scene)
+	{
+		for (PxU32 i = 0; i < warmup_steps; i++)
+			scene->Update(time_step);
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (PxU32 i = 0; i < timed_steps; i++)
+			scene->Update(time_step);
+		chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+
+		return elapsed.count() / timed_steps;
+	}
+
+	///A single cloth hanging above the ground plane
+	class ClothScene : public Scene
+	{
+		PxU32 resolution;
+		PxReal solver_frequency;
+		Plane* plane;
+		Cloth* cloth;
+
+	public:
+		ClothScene(PxU32 _resolution, PxReal _solver_frequency)
+			: resolution(_resolution), solver_frequency(_solver_frequency), plane(0), cloth(0) {}
+
+		~ClothScene()
+		{
+			delete cloth;
+			delete plane;
+		}
+
+		virtual void CustomInit()
+		{
+			plane = new Plane();
+			Add(plane);
+
+			cloth = new Cloth(PxTransform(PxVec3(-4.f, 9.f, 0.f)), PxVec2(8.f, 8.f), resolution, resolution);
+			cloth->SolverFrequency(solver_frequency);
+			Add(cloth);
+		}
+	};
+
+	///Fast spheres shot at a thin wall
+	class TunnelScene : public Scene
+	{
+		bool ccd;
+		Box* wall;
+		vector<Sphere*> balls;
+
+	public:
+		//x coordinate of the wall
+		static const PxReal wall_x;
+
+		TunnelScene(bool _ccd) : Scene(TableFilterShader<GamePairPolicy>), ccd(_ccd), wall(0) {}
+
+		~TunnelScene()
+		{
+			for (unsigned int i = 0; i < balls.size(); i++)
+				delete balls[i];
+			delete wall;
+		}
+
+		virtual void CustomInit()
+		{
+			px_scene->setGravity(PxVec3(0.f, 0.f, 0.f));
+
+			wall = new Box(PxTransform(PxVec3(wall_x, 0.f, 0.f)), PxVec3(.1f, 20.f, 20.f));
+			wall->SetupFiltering(FilterGroup::Boundary, 0);
+			Add(wall);
+
+			for (PxU32 i = 0; i < 100; i++)
+			{
+				//a spread of speeds between the flipper and the motor arm rebounds
+				Sphere* ball = new Sphere(PxTransform(PxVec3(0.f, -15.f + 3.f*(i / 10), -15.f + 3.f*(i % 10))), .5f);
+				ball->SetupFiltering(FilterGroup::Sphere, 0);
+				ball->SetCCD(ccd);
+				((PxRigidDynamic*)ball->Get())->setLinearVelocity(PxVec3(60.f + 2.f*i, 0.f, 0.f));
+				balls.push_back(ball);
+				Add(ball);
+			}
+		}
+
+		///Number of balls that went through the wall
+		PxU32 Tunnelled()
+		{
+			PxU32 count = 0;
+			for (unsigned int i = 0; i < balls.size(); i++)
+				if (((PxRigidDynamic*)balls[i]->Get())->getGlobalPose().p.x > wall_x)
+					count++;
+			return count;
+		}
+	};
+
+	const PxReal TunnelScene::wall_x = 10.f;
+
+	///Cost of CCD compared with shrinking the time step
+	static void CCDCost()
+	{
+		struct Setup { const char* name; bool ccd; PxU32 steps_per_frame; };
+		static const Setup setups[] = {
+			{ "discrete, dt", false, 1 },
+			{ "discrete, dt/2", false, 2 },
+			{ "discrete, dt/4", false, 4 },
+			{ "CCD, dt", true, 1 } };
+
+		cout << "CCD cost (1s of 100 balls hitting a wall, dt = 1/" << (int)(1.f/time_step) << "s)" << endl;
+		cout << setw(16) << "" << " | " << setw(10) << "ms/frame" << setw(12) << "tunnelled" << endl;
+
+		for (const Setup& setup : setups)
+		{
+			TunnelScene* scene = new TunnelScene(setup.ccd);
+			scene->Init();
+
+			PxU32 frames = (PxU32)(1.f / time_step);
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			for (PxU32 i = 0; i < frames; i++)
+				for (PxU32 j = 0; j < setup.steps_per_frame; j++)
+					scene->Update(time_step / setup.steps_per_frame);
+			chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+
+			cout << setw(16) << left << setup.name << right << " | " << setw(10) << fixed << setprecision(3) << elapsed.count() / frames
+				<< setw(12) << scene->Tunnelled() << endl;
+
+			scene->Release();
+			delete scene;
+		}
+	}
+
+	///Joint-held dynamic players compared with kinematic players in a bot match
+	static void PlayerModes()
+	{
+		static const PxReal step = 1.f/120.f;
+		static const PxU32 steps = 2400;
+
+		cout << "Player modes (" << steps << " steps of a bot match)" << endl;
+		cout << setw(10) << "players" << " | " << setw(10) << "ms/step" << setw(13) << "constraints" << setw(16) << "max height err" << setw(14) << "max tilt deg" << endl;
+
+		for (int kinematic = 0; kinematic < 2; kinematic++)
+		{
+			MyScene* scene = new MyScene();
+			scene->kinematicPlayers = (kinematic != 0);
+			scene->Init();
+
+			PxRigidDynamic* ball = (PxRigidDynamic*)scene->sphere->Get();
+			ball->addForce(PxVec3(1.f, 0.f, 1.f)*200.f*step, PxForceMode::eIMPULSE);
+
+			double time = 0.;
+			PxReal height_error = 0.f, tilt = 0.f;
+			for (PxU32 i = 0; i < steps; i++)
+			{
+				scene->controllers[0]->PushTowards(ball->getGlobalPose().p);
+				scene->controllers[1]->PushTowards(ball->getGlobalPose().p);
+
+				chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+				scene->Update(step);
+				time += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+				//players should stay upright on the ice
+				for (int j = 0; j < 2; j++)
+				{
+					PxTransform pose = scene->controllers[j]->Get()->getGlobalPose();
+					height_error = PxMax(height_error, PxAbs(pose.p.y - 2.5f));
+					tilt = PxMax(tilt, PxAcos(PxClamp(pose.q.getBasisVector1().y, -1.f, 1.f)));
+				}
+			}
+
+			cout << setw(10) << (kinematic ? "kinematic" : "D6 joint") << " | " << setw(10) << fixed << setprecision(4) << time / steps
+				<< setw(13) << scene->Get()->getNbConstraints() << setw(16) << height_error << setw(14) << tilt*180.f/PxPi << endl;
+
+			scene->Release();
+			delete scene;
+		}
+	}
+
+	///Cost of a cloth step against the grid resolution and the solver frequency
+	static void ClothCost()
+	{
+		static const PxU32 resolutions[] = { 8, 16, 32, 64 };
+		static const PxReal frequencies[] = { 60.f, 120.f, 240.f, 480.f };
+
+		cout << "Cloth cost (ms per step)" << endl;
+		cout << setw(12) << "quads" << " |";
+		for (PxReal frequency : frequencies)
+			cout << setw(8) << frequency << "Hz";
+		cout << endl;
+
+		for (PxU32 resolution : resolutions)
+		{
+			cout << setw(5) << resolution << "x" << setw(6) << left << resolution << right << " |";
+			for (PxReal frequency : frequencies)
+			{
+				ClothScene* scene = new ClothScene(resolution, frequency);
+				scene->Init();
+				double ms = TimeSteps(scene);
+				scene->Release();
+				delete scene;
+
+				cout << setw(10) << fixed << setprecision(3) << ms;
+			}
+			cout << endl;
+		}
+	}
+
+	///Balls spawned and despawned every frame, created on demand or taken from a pool
+	static void SpawnCost()
+	{
+		static const PxU32 frames = 300;
+		static const PxU32 balls = 20;
+
+		cout << "Spawn cost (" << balls << " balls spawned and despawned every frame)" << endl;
+		cout << setw(10) << "balls" << " | " << setw(10) << "ms/frame" << endl;
+
+		for (int pooled = 0; pooled < 2; pooled++)
+		{
+			Scene* scene = new Scene();
+			scene->Init();
+
+			ActorPool* pool = 0;
+			if (pooled)
+				pool = new ActorPool(scene, balls, []() -> DynamicActor* { return new Sphere(PxTransform(PxVec3(0.f)), .5f); });
+
+			vector<DynamicActor*> spawned;
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			for (PxU32 i = 0; i < frames; i++)
+			{
+				for (PxU32 j = 0; j < balls; j++)
+				{
+					PxTransform pose(PxVec3(2.f*j, 1.f, 0.f));
+					DynamicActor* ball;
+					if (pool)
+						ball = pool->Spawn(pose);
+					else
+					{
+						ball = new Sphere(pose, .5f);
+						scene->Add(ball);
+					}
+					spawned.push_back(ball);
+				}
+
+				scene->Update(time_step);
+
+				for (unsigned int j = 0; j < spawned.size(); j++)
+				{
+					if (pool)
+						pool->Despawn(spawned[j]);
+					else
+					{
+						scene->Remove(spawned[j]);
+						delete spawned[j];
+					}
+				}
+				spawned.clear();
+			}
+			chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+
+			cout << setw(10) << (pooled ? "pooled" : "created") << " | " << setw(10) << fixed << setprecision(3) << elapsed.count() / frames << endl;
+
+			delete pool;
+			scene->Release();
+			delete scene;
+		}
+	}
+
+	bool Run(const char* name)
+	{
+		void (*benchmark)() = 0;
+
+		if (!strcmp(name, "cloth"))
+			benchmark = ClothCost;
+		else if (!strcmp(name, "ccd"))
+			benchmark = CCDCost;
+		else if (!strcmp(name, "players"))
+			benchmark = PlayerModes;
+		else if (!strcmp(name, "spawn"))
+			benchmark = SpawnCost;
+
+		if (!benchmark)
+			return false;
+
+		PxInit();
+		benchmark();
+		PxRelease();
+
+		return true;
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Benchmarks
+{
+	///Run a named benchmark and print the results to the console
+	///returns false if there is no benchmark with that name
+	bool Run(const char* name);
+}
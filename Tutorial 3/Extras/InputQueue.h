@@ -0,0 +1,90 @@
+#pragma once
+
+#include "PxPhysicsAPI.h"
+#include <deque>
+#include <vector>
+
+namespace VisualDebugger
+{
+	using namespace physx;
+	using namespace std;
+
+	///A timestamped movement action, e.g. "player 1 +x" pressed or released
+	struct InputAction
+	{
+		//time (in seconds) of the key event
+		double time;
+		//key that started the action, a release stops the press with the same key
+		int key;
+		//index of the pushed player
+		int player;
+		//direction of the push
+		PxVec3 direction;
+		//key pressed or released
+		bool pressed;
+	};
+
+	///Queue of input actions consumed at the granularity of the simulation steps
+	class InputQueue
+	{
+		deque<InputAction> actions;
+		//presses without a release yet
+		vector<InputAction> held;
+
+	public:
+		///Add an action, actions have to be pushed in time order
+		void Push(const InputAction& action)
+		{
+			actions.push_back(action);
+		}
+
+		///Consume the actions up to the end of the step [start, end) and return the average push of each player
+		///(a key held for the whole step gives a push of 1, a key held for half of it 0.5)
+		void Step(double start, double end, vector<PxVec3>& push)
+		{
+			for (unsigned int i = 0; i < push.size(); i++)
+				push[i] = PxVec3(0.f, 0.f, 0.f);
+
+			double duration = end - start;
+			double time = start;
+
+			while (true)
+			{
+				//held keys push until the next action inside the step (late actions are moved to the start)
+				bool next_action = actions.size() && (actions.front().time < end);
+				double next = next_action ? PxMax(actions.front().time, start) : end;
+
+				for (unsigned int i = 0; i < held.size(); i++)
+					if (held[i].player < (int)push.size())
+						push[held[i].player] += held[i].direction*(PxReal)((next - time) / duration);
+
+				time = next;
+
+				if (!next_action)
+					break;
+
+				//apply the action
+				const InputAction& action = actions.front();
+				for (unsigned int i = 0; i < held.size(); i++)
+				{
+					if (held[i].key == action.key)
+					{
+						held.erase(held.begin() + i);
+						break;
+					}
+				}
+				if (action.pressed)
+					held.push_back(action);
+
+				actions.pop_front();
+			}
+		}
+
+		///Drop all actions and held keys
+		void Clear()
+		{
+			actions.clear();
+			held.clear();
+		}
+	};
+}
@@ -0,0 +1,89 @@
+#include "RenderTable.h"
+
+using namespace physx;
+
+RenderTable& RenderTable::Get()
+{
+	static RenderTable table;
+	return table;
+}
+
+PxU32 RenderTable::Create(const PxVec3& _color, PxClothMeshDesc* _cloth_mesh_desc, PxU8 _flags)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	PxU32 row;
+	if (free_rows.size())
+	{
+		row = free_rows.back();
+		free_rows.pop_back();
+	}
+	else
+	{
+		row = (PxU32)color.size();
+		color.push_back(PxVec3(0.f));
+		flags.push_back(0);
+		lod.push_back(-1);
+		pose.push_back(PxTransform(PxVec3(0.f)));
+		bounds.push_back(PxBounds3::empty());
+		cloth_mesh_desc.push_back(0);
+	}
+
+	color[row] = _color;
+	flags[row] = _flags;
+	lod[row] = -1;
+	cloth_mesh_desc[row] = _cloth_mesh_desc;
+
+	return row;
+}
+
+void RenderTable::Release(PxU32 row)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (row < color.size())
+	{
+		cloth_mesh_desc[row] = 0;
+		free_rows.push_back(row);
+	}
+}
+
+
+PxU32 RenderTable::Size()
+{
+	return (PxU32)color.size();
+}
+
+void RenderTable::Color(PxU32 row, const PxVec3& value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (row < color.size())
+	{
+		color[row] = value;
+		if (flags[row] & STATIC)
+			static_revision++;
+	}
+}
+
+void RenderTable::StaticChanged()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	static_revision++;
+}
+
+PxU32 RenderTable::StaticRevision()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return static_revision;
+}
+
+void RenderTable::Flags(PxU32 row, PxU8 mask, bool value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (row < flags.size())
+		flags[row] = value ? (flags[row] | mask) : (flags[row] & ~mask);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "PxPhysicsAPI.h"
+#include <vector>
+#include <mutex>
+
+//add here any other attributes that you want to pass from your simulation to the renderer
+///Render attributes of all shapes (and cloths) kept in flat arrays, one row per shape
+///The row of a shape is stored in its userData (see Attach and Row), the renderer reads the columns directly
+///Meshes are not kept here: the renderer finds them by geometry in its own caches, which it can clear at any time
+class RenderTable
+{
+public:
+	///Render flags of a row
+	enum Flag
+	{
+		//the owning actor sleeps, the renderer then reuses the cached pose and bounds
+		SLEEPING = (1 << 0),
+		//pose and bounds hold the values of the sleeping shape
+		CACHED = (1 << 1),
+		//draw the shape brighter (selected actor)
+		HIGHLIGHT = (1 << 2),
+		//shape of a static actor, baked into the static batch by the renderer
+		STATIC = (1 << 3)
+	};
+
+	//row of a shape without one
+	static const physx::PxU32 NONE = 0xffffffff;
+
+	//the columns, all of the same size
+	std::vector<physx::PxVec3> color;
+	std::vector<physx::PxU8> flags;
+	//level of detail of the mesh last used to draw the shape (-1 = none yet)
+	std::vector<int> lod;
+	std::vector<physx::PxTransform> pose;
+	std::vector<physx::PxBounds3> bounds;
+	std::vector<physx::PxClothMeshDesc*> cloth_mesh_desc;
+
+	///The table shared by all scenes
+	static RenderTable& Get();
+
+	///Add a row (released rows are reused first)
+	physx::PxU32 Create(const physx::PxVec3& color, physx::PxClothMeshDesc* cloth_mesh_desc=0, physx::PxU8 flags=0);
+
+	///Return a row to the table
+	void Release(physx::PxU32 row);
+
+	///Number of rows (including the released ones)
+	physx::PxU32 Size();
+
+	///Change the color of a row (a change of a STATIC row invalidates the static batch)
+	void Color(physx::PxU32 row, const physx::PxVec3& value);
+
+	///Mark the baked state of the static shapes (colors, poses) as changed
+	void StaticChanged();
+
+	///Revision of the baked state of the static shapes
+	physx::PxU32 StaticRevision();
+
+	///Set or clear render flags of a row
+	void Flags(physx::PxU32 row, physx::PxU8 mask, bool value);
+
+	///Value for userData that points to a row
+	static void* Attach(physx::PxU32 row) { return (void*)(size_t)(row + 1); }
+
+	///Row stored in userData (NONE if there is none)
+	static physx::PxU32 Row(const void* user_data) { return (physx::PxU32)((size_t)user_data - 1); }
+
+private:
+	//creating, releasing and changing rows can happen on several simulation threads,
+	//rendering reads the columns without locking on the main thread
+	std::mutex mutex;
+	std::vector<physx::PxU32> free_rows;
+	physx::PxU32 static_revision = 0;
+};
@@ -1,7 +1,14 @@
 #include "Renderer.h"
 #include <iostream>
 #include <vector>
-#include "UserData.h"
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstring>
+#include <emmintrin.h>
+#include "RenderTable.h"
 
 using namespace std;
 
@@ -14,6 +21,168 @@ namespace VisualDebugger
 		int render_detail = 10;
 		bool show_shadows = true;
 
+		//planar projection used for the shadows
+		const PxVec3 shadowDir(-0.7071067f, -0.7071067f, -0.7071067f);
+		const PxReal shadowMat[]={ 1,0,0,0, -shadowDir.x/shadowDir.y,0,-shadowDir.z/shadowDir.y,0, 0,0,1,0, 0,0,0,1 };
+
+		///Static geometry baked into world space
+		struct StaticBatch
+		{
+			bool valid;
+			std::vector<PxVec3> verts;
+			std::vector<PxVec3> normals;
+			std::vector<PxVec3> colors;
+			//static shapes that are not baked (planes etc.)
+			std::vector<const PxShape*> shapes;
+			PxVec3 shadow_color;
+			PxBounds3 bounds;
+
+			StaticBatch() : valid(false), shadow_color(0.72f, 0.72f, 0.72f) {}
+		};
+
+		StaticBatch static_batch;
+
+		///View frustum planes (normals pointing inwards)
+		struct Frustum
+		{
+			bool valid;
+			PxPlane planes[6];
+
+			Frustum() : valid(false) {}
+
+			///Test an axis aligned box against all planes
+			bool IsVisible(const PxBounds3& bounds) const
+			{
+				if (!valid)
+					return true;
+
+				PxVec3 center = bounds.getCenter();
+				PxVec3 extents = bounds.getExtents();
+				for (PxU32 i = 0; i < 6; i++)
+				{
+					const PxVec3& n = planes[i].n;
+					PxReal radius = PxAbs(n.x)*extents.x + PxAbs(n.y)*extents.y + PxAbs(n.z)*extents.z;
+					if (planes[i].distance(center) + radius < 0.f)
+						return false;
+				}
+				return true;
+			}
+		};
+
+		Frustum frustum;
+		RenderStats render_stats;
+
+		//perspective used in Start()
+		const PxReal fov_y = 60.f;
+		const PxReal z_near = 1.f;
+		const PxReal z_far = 10000.f;
+
+		//camera position and viewport height of the current frame
+		PxVec3 camera_eye(0.f, 0.f, 0.f);
+		PxReal viewport_height = 1.f;
+
+		///Indexed triangle mesh kept in client memory
+		struct MeshBuffer
+		{
+			std::vector<PxVec3> verts;
+			std::vector<PxVec3> normals;
+			std::vector<PxU32> indices;
+		};
+
+		///Level of detail for spheres and capsules
+		const int num_lods = 4;
+		//minimum projected radius (in pixels) for each level, finest first
+		const PxReal lod_pixel_radius[num_lods] = { 80.f, 30.f, 10.f, 0.f };
+		//a level only changes when the size moves this far past a threshold
+		const PxReal lod_hysteresis = .15f;
+		//above this many vertices of round shapes per frame, they fall back to the coarsest level
+		const PxU32 lod_vertex_budget = 250000;
+		PxU32 lod_vertex_count = 0;
+
+		//sphere meshes per (radius, detail)
+		std::map<std::pair<PxReal, int>, MeshBuffer> sphere_meshes;
+
+		struct CapsuleKey
+		{
+			PxReal radius, halfHeight;
+			int detail;
+
+			CapsuleKey(PxReal _radius, PxReal _halfHeight, int _detail) : radius(_radius), halfHeight(_halfHeight), detail(_detail) {}
+
+			bool operator<(const CapsuleKey& other) const
+			{
+				if (radius != other.radius)
+					return radius < other.radius;
+				if (halfHeight != other.halfHeight)
+					return halfHeight < other.halfHeight;
+				return detail < other.detail;
+			}
+		};
+
+		//capsule meshes per (radius, half height, detail)
+		std::map<CapsuleKey, MeshBuffer> capsule_meshes;
+
+		//render buffers of cooked triangle meshes
+		std::map<const PxTriangleMesh*, MeshBuffer> triangle_meshes;
+
+		//render buffers of cooked convex meshes, shared by all actors using the same mesh
+		std::map<const PxConvexMesh*, MeshBuffer> convex_meshes;
+
+		///A block of heightfield cells with its own buffer and local bounds
+		struct HeightFieldChunk
+		{
+			MeshBuffer mesh;
+			PxBounds3 bounds;
+		};
+
+		struct HeightFieldKey
+		{
+			const PxHeightField* height_field;
+			PxReal height_scale, row_scale, column_scale;
+
+			HeightFieldKey(const PxHeightFieldGeometry& geometry) : height_field(geometry.heightField),
+				height_scale(geometry.heightScale), row_scale(geometry.rowScale), column_scale(geometry.columnScale) {}
+
+			bool operator<(const HeightFieldKey& other) const
+			{
+				if (height_field != other.height_field)
+					return height_field < other.height_field;
+				if (height_scale != other.height_scale)
+					return height_scale < other.height_scale;
+				if (row_scale != other.row_scale)
+					return row_scale < other.row_scale;
+				return column_scale < other.column_scale;
+			}
+		};
+
+		//number of cells along each side of a heightfield chunk
+		const PxU32 height_field_chunk_size = 32;
+
+		//chunked render buffers of heightfields
+		std::map<HeightFieldKey, std::vector<HeightFieldChunk> > height_field_meshes;
+
+		///Persistent per-cloth buffers, reused every frame
+		struct ClothBuffer
+		{
+			//particles are copied as they are (position + inverse weight, 16 bytes)
+			std::vector<PxClothParticle> particles;
+			std::vector<PxVec4> quad_normals;
+			std::vector<PxVec4> normals;
+			//quads touching each particle: vertex_quads[vertex_quad_start[i]..vertex_quad_start[i+1])
+			std::vector<PxU32> vertex_quad_start;
+			std::vector<PxU32> vertex_quads;
+			//last frame the cloth was rendered, buffers of released cloths are dropped
+			PxU32 frame;
+
+			ClothBuffer() : frame(0) {}
+		};
+
+		std::map<const PxCloth*, ClothBuffer> cloth_buffers;
+		PxU32 frame = 0;
+
+		//cloths with at least this many quads have their normals computed on several threads
+		const PxU32 cloth_parallel_quads = 8192;
+
 		static float gPlaneData[]={
 			-1.f, 0.f, -1.f, 0.f, 1.f, 0.f, -1.f, 0.f, 1.f, 0.f, 1.f, 0.f,
 			1.f, 0.f, 1.f, 0.f, 1.f, 0.f, -1.f, 0.f, -1.f, 0.f, 1.f, 0.f,
@@ -32,9 +201,108 @@ namespace VisualDebugger
 			glDisableClientState(GL_NORMAL_ARRAY);
 		}
 
-		void DrawSphere(const PxGeometryHolder& geometry)
+		void DrawMesh(const MeshBuffer& mesh)
+		{
+			if (!mesh.indices.size())
+				return;
+
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glVertexPointer(3, GL_FLOAT, sizeof(PxVec3), &mesh.verts.front());
+			glNormalPointer(GL_FLOAT, sizeof(PxVec3), &mesh.normals.front());
+			glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, &mesh.indices.front());
+			glDisableClientState(GL_NORMAL_ARRAY);
+			glDisableClientState(GL_VERTEX_ARRAY);
+		}
+
+		///Draw a level of detail mesh of a round shape and count it against the budget
+		void DrawLodMesh(const MeshBuffer& mesh)
+		{
+			DrawMesh(mesh);
+			lod_vertex_count += (PxU32)mesh.verts.size();
+		}
+
+		///Tessellation (slices and stacks) of the given level of detail
+		int LodDetail(int lod)
+		{
+			return PxMax(render_detail >> lod, 6);
+		}
+
+		///Pick a level of detail for a round shape from its projected size on the screen
+		int SelectLod(const PxVec3& center, PxReal radius, PxU32 row)
+		{
+			if (lod_vertex_count > lod_vertex_budget)
+				return num_lods-1;
+
+			PxReal distance = PxMax((center - camera_eye).magnitude(), z_near);
+			PxReal pixel_radius = radius / (distance * PxTan(fov_y*0.5f*PxPi/180.f)) * viewport_height * 0.5f;
+
+			int lod = num_lods-1;
+			for (int i = 0; i < num_lods; i++)
+			{
+				if (pixel_radius >= lod_pixel_radius[i])
+				{
+					lod = i;
+					break;
+				}
+			}
+
+			RenderTable& table = RenderTable::Get();
+			if (row >= table.Size())
+				return lod;
+
+			//hysteresis: keep the previous level unless the size clearly crossed its boundary
+			int prev = table.lod[row];
+			if ((prev >= 0) && (prev < num_lods) && (lod != prev))
+			{
+				if ((lod < prev) && (pixel_radius < lod_pixel_radius[prev-1]*(1.f + lod_hysteresis)))
+					lod = prev;
+				else if ((lod > prev) && (pixel_radius > lod_pixel_radius[prev]*(1.f - lod_hysteresis)))
+					lod = prev;
+			}
+
+			table.lod[row] = lod;
+			return lod;
+		}
+
+		///Build a sphere mesh with the given number of slices and stacks
+		void BuildSphere(MeshBuffer& mesh, PxReal radius, int detail)
+		{
+			int slices = detail, stacks = detail;
+			for (int i = 0; i <= stacks; i++)
+			{
+				PxReal phi = PxPi * i / stacks;
+				for (int j = 0; j <= slices; j++)
+				{
+					PxReal theta = PxTwoPi * j / slices;
+					PxVec3 n(PxSin(phi)*PxCos(theta), PxSin(phi)*PxSin(theta), PxCos(phi));
+					mesh.verts.push_back(n*radius);
+					mesh.normals.push_back(n);
+				}
+			}
+
+			for (int i = 0; i < stacks; i++)
+			{
+				for (int j = 0; j < slices; j++)
+				{
+					PxU32 i0 = i*(slices+1) + j;
+					PxU32 i1 = i0 + slices+1;
+					mesh.indices.push_back(i0);
+					mesh.indices.push_back(i1);
+					mesh.indices.push_back(i0+1);
+					mesh.indices.push_back(i0+1);
+					mesh.indices.push_back(i1);
+					mesh.indices.push_back(i1+1);
+				}
+			}
+		}
+
+		void DrawSphere(const PxGeometryHolder& geometry, int detail)
 		{
-			glutSolidSphere(geometry.sphere().radius, render_detail, render_detail);
+			MeshBuffer& mesh = sphere_meshes[std::make_pair(geometry.sphere().radius, detail)];
+			if (!mesh.verts.size())
+				BuildSphere(mesh, geometry.sphere().radius, detail);
+			DrawLodMesh(mesh);
 		}
 
 		void DrawBox(const PxGeometryHolder& geometry)
@@ -44,38 +312,62 @@ namespace VisualDebugger
 			glutSolidCube(2.f);		
 		}
 
-		void DrawCapsule(const PxGeometryHolder& geometry)
+		///Build a capsule mesh along the X axis: two hemispheres joined by a cylinder
+		void BuildCapsule(MeshBuffer& mesh, PxReal radius, PxReal halfHeight, int detail)
 		{
-			const PxF32 radius = geometry.capsule().radius;
-			const PxF32 halfHeight = geometry.capsule().halfHeight;
+			int slices = detail;
+			//an even number of stacks puts a ring exactly on the equator
+			int stacks = (detail + 1) & ~1;
 
-			//Sphere
-			glPushMatrix();
-			glTranslatef(halfHeight,0.f, 0.f);
-			glutSolidSphere(radius, render_detail, render_detail);		
-			glPopMatrix();
+			//the equator ring is emitted twice, once per cap, the band between them is the cylinder
+			int rings = 0;
+			for (int i = 0; i <= stacks; i++)
+			{
+				PxReal phi = PxPi * i / stacks;
+				int copies = (i == stacks/2) ? 2 : 1;
+				for (int c = 0; c < copies; c++, rings++)
+				{
+					PxReal offset = ((i < stacks/2) || ((i == stacks/2) && (c == 0))) ? halfHeight : -halfHeight;
+					for (int j = 0; j <= slices; j++)
+					{
+						PxReal theta = PxTwoPi * j / slices;
+						PxVec3 n(PxCos(phi), PxSin(phi)*PxCos(theta), PxSin(phi)*PxSin(theta));
+						mesh.verts.push_back(n*radius + PxVec3(offset, 0.f, 0.f));
+						mesh.normals.push_back(n);
+					}
+				}
+			}
 
-			//Sphere
-			glPushMatrix();
-			glTranslatef(-halfHeight,0.f,0.f);
-			glutSolidSphere(radius, render_detail, render_detail);		
-			glPopMatrix();
+			for (int i = 0; i < rings-1; i++)
+			{
+				for (int j = 0; j < slices; j++)
+				{
+					PxU32 i0 = i*(slices+1) + j;
+					PxU32 i1 = i0 + slices+1;
+					mesh.indices.push_back(i0);
+					mesh.indices.push_back(i1);
+					mesh.indices.push_back(i0+1);
+					mesh.indices.push_back(i0+1);
+					mesh.indices.push_back(i1);
+					mesh.indices.push_back(i1+1);
+				}
+			}
+		}
 
-			//Cylinder
-			glPushMatrix();
-			glTranslatef(-halfHeight,0.f,0.f);
-			glRotatef(90.f,0.f,1.f,0.f);
+		void DrawCapsule(const PxGeometryHolder& geometry, int detail)
+		{
+			const PxF32 radius = geometry.capsule().radius;
+			const PxF32 halfHeight = geometry.capsule().halfHeight;
 
-			GLUquadric* qobj = gluNewQuadric();
-			gluQuadricNormals(qobj, GLU_SMOOTH);
-			gluCylinder(qobj, radius, radius, halfHeight*2.f, render_detail, render_detail);
-			gluDeleteQuadric(qobj);
-			glPopMatrix();
+			MeshBuffer& mesh = capsule_meshes[CapsuleKey(radius, halfHeight, detail)];
+			if (!mesh.verts.size())
+				BuildCapsule(mesh, radius, halfHeight, detail);
+			DrawLodMesh(mesh);
 		}
 
-		void DrawConvexMesh(const PxGeometryHolder& geometry)
+		///Triangulate the hull polygons of a convex mesh, vertices are duplicated per face for flat normals
+		void BuildConvexMesh(MeshBuffer& buffer, const PxConvexMesh* mesh)
 		{
-			PxConvexMesh* mesh = geometry.convexMesh().convexMesh;
 			PxU32 num_polys = mesh->getNbPolygons();
 			const PxVec3* verts = mesh->getVertices();
 			const PxU8* indicies = mesh->getIndexBuffer();
@@ -85,48 +377,172 @@ namespace VisualDebugger
 				PxHullPolygon face;
 				if (mesh->getPolygonData(i,face))
 				{
-					glBegin(GL_POLYGON);
-					glNormal3f(face.mPlane[0],face.mPlane[1],face.mPlane[2]);
+					PxVec3 normal(face.mPlane[0], face.mPlane[1], face.mPlane[2]);
+					PxU32 base = (PxU32)buffer.verts.size();
 					const PxU8* faceIdx = indicies + face.mIndexBase;
 					for (PxU32 j = 0; j < face.mNbVerts; j++)
 					{
-						PxVec3 v = verts[faceIdx[j]];
-						glVertex3f(v.x,v.y,v.z);
+						buffer.verts.push_back(verts[faceIdx[j]]);
+						buffer.normals.push_back(normal);
+					}
+
+					//hull polygons are convex, so a fan is enough
+					for (PxU32 j = 1; j + 1 < face.mNbVerts; j++)
+					{
+						buffer.indices.push_back(base);
+						buffer.indices.push_back(base + j);
+						buffer.indices.push_back(base + j + 1);
 					}
-					glEnd();
 				}
 			}
 		}
 
-		void DrawTriangleMesh(const PxGeometryHolder& geometry)
+		void DrawConvexMesh(const PxGeometryHolder& geometry)
+		{
+			const PxConvexMesh* mesh = geometry.convexMesh().convexMesh;
+			MeshBuffer& buffer = convex_meshes[mesh];
+			if (!buffer.verts.size())
+				BuildConvexMesh(buffer, mesh);
+			DrawMesh(buffer);
+		}
+
+		///Convert a triangle mesh into a buffer with flat face normals, vertices are duplicated per triangle to keep the hard edges
+		void BuildTriangleMesh(MeshBuffer& buffer, const PxTriangleMesh* mesh)
 		{
-			PxTriangleMesh* mesh = geometry.triangleMesh().triangleMesh;
 			const PxVec3* verts = mesh->getVertices();
-			PxU16* trigs = (PxU16*)mesh->getTriangles();
 			const PxU32 num_trigs = mesh->getNbTriangles();
+			//cooked meshes store either 16 or 32 bit indices
+			const bool indices16 = (mesh->getTriangleMeshFlags() & PxTriangleMeshFlag::eHAS_16BIT_TRIANGLE_INDICES);
+			const PxU16* trigs16 = (const PxU16*)mesh->getTriangles();
+			const PxU32* trigs32 = (const PxU32*)mesh->getTriangles();
+
+			buffer.verts.resize(num_trigs*3);
+			buffer.normals.resize(num_trigs*3);
+			buffer.indices.resize(num_trigs*3);
 
 			for (PxU32 i = 0; i < num_trigs*3; i+=3)
 			{
-				PxVec3 v0 = verts[trigs[i]];
-				PxVec3 v1 = verts[trigs[i+1]];
-				PxVec3 v2 = verts[trigs[i+2]];
-				PxVec3 n = (v1-v0).cross(v2-v0);
+				for (PxU32 j = 0; j < 3; j++)
+				{
+					buffer.verts[i+j] = verts[indices16 ? trigs16[i+j] : trigs32[i+j]];
+					buffer.indices[i+j] = i+j;
+				}
+
+				PxVec3 n = (buffer.verts[i+1]-buffer.verts[i]).cross(buffer.verts[i+2]-buffer.verts[i]);
 				n.normalize();
-				glBegin(GL_POLYGON);
-				glNormal3f(n.x, n.y, n.z);
-				glVertex3f(v0.x, v0.y, v0.z);
-				glVertex3f(v1.x, v1.y, v1.z);
-				glVertex3f(v2.x, v2.y, v2.z);
-				glEnd();
+				buffer.normals[i] = buffer.normals[i+1] = buffer.normals[i+2] = n;
 			}
 		}
 
-		void DrawHeightField(const PxGeometryHolder& geometry)
+		void DrawTriangleMesh(const PxGeometryHolder& geometry)
 		{
-			//TODO
+			const PxTriangleMesh* mesh = geometry.triangleMesh().triangleMesh;
+			MeshBuffer& buffer = triangle_meshes[mesh];
+			if (!buffer.verts.size())
+				BuildTriangleMesh(buffer, mesh);
+			DrawMesh(buffer);
 		}
 
-		void RenderGeometry(const PxGeometryHolder& geometry)
+		///Split a heightfield into chunks of cells, each with its own vertex buffer
+		void BuildHeightField(std::vector<HeightFieldChunk>& chunks, const PxHeightFieldGeometry& geometry)
+		{
+			const PxHeightField* height_field = geometry.heightField;
+			const PxU32 rows = height_field->getNbRows();
+			const PxU32 columns = height_field->getNbColumns();
+
+			std::vector<PxHeightFieldSample> samples(rows*columns);
+			height_field->saveCells(&samples.front(), (PxU32)(samples.size()*sizeof(PxHeightFieldSample)));
+
+			//positions and smooth normals of the whole grid, so that chunk borders match
+			std::vector<PxVec3> verts(rows*columns);
+			std::vector<PxVec3> normals(rows*columns);
+			for (PxU32 r = 0; r < rows; r++)
+				for (PxU32 c = 0; c < columns; c++)
+					verts[r*columns + c] = PxVec3(r*geometry.rowScale, samples[r*columns + c].height*geometry.heightScale, c*geometry.columnScale);
+
+			for (PxU32 r = 0; r < rows; r++)
+			{
+				for (PxU32 c = 0; c < columns; c++)
+				{
+					PxU32 r0 = (r > 0) ? r-1 : r, r1 = (r+1 < rows) ? r+1 : r;
+					PxU32 c0 = (c > 0) ? c-1 : c, c1 = (c+1 < columns) ? c+1 : c;
+					PxVec3 dx = verts[r1*columns + c] - verts[r0*columns + c];
+					PxVec3 dz = verts[r*columns + c1] - verts[r*columns + c0];
+					normals[r*columns + c] = dz.cross(dx).getNormalized();
+				}
+			}
+
+			for (PxU32 chunk_r = 0; chunk_r + 1 < rows; chunk_r += height_field_chunk_size)
+			{
+				for (PxU32 chunk_c = 0; chunk_c + 1 < columns; chunk_c += height_field_chunk_size)
+				{
+					PxU32 last_r = PxMin(chunk_r + height_field_chunk_size, rows-1);
+					PxU32 last_c = PxMin(chunk_c + height_field_chunk_size, columns-1);
+					PxU32 chunk_columns = last_c - chunk_c + 1;
+
+					chunks.push_back(HeightFieldChunk());
+					HeightFieldChunk& chunk = chunks.back();
+					chunk.bounds = PxBounds3::empty();
+
+					for (PxU32 r = chunk_r; r <= last_r; r++)
+					{
+						for (PxU32 c = chunk_c; c <= last_c; c++)
+						{
+							chunk.mesh.verts.push_back(verts[r*columns + c]);
+							chunk.mesh.normals.push_back(normals[r*columns + c]);
+							chunk.bounds.include(verts[r*columns + c]);
+						}
+					}
+
+					for (PxU32 r = chunk_r; r < last_r; r++)
+					{
+						for (PxU32 c = chunk_c; c < last_c; c++)
+						{
+							const PxHeightFieldSample& sample = samples[r*columns + c];
+							PxU32 v00 = (r-chunk_r)*chunk_columns + (c-chunk_c);
+							PxU32 v01 = v00 + 1;
+							PxU32 v10 = v00 + chunk_columns;
+							PxU32 v11 = v10 + 1;
+
+							//the tessellation flag selects the cell diagonal, holes are skipped
+							PxU32 trigs[6] = { v00, v01, v11, v00, v11, v10 };
+							if (!sample.tessFlag())
+							{
+								trigs[2] = v10;
+								trigs[3] = v01;
+								trigs[4] = v11;
+							}
+
+							if (sample.materialIndex0 != PxHeightFieldMaterial::eHOLE)
+								chunk.mesh.indices.insert(chunk.mesh.indices.end(), trigs, trigs+3);
+							if (sample.materialIndex1 != PxHeightFieldMaterial::eHOLE)
+								chunk.mesh.indices.insert(chunk.mesh.indices.end(), trigs+3, trigs+6);
+						}
+					}
+				}
+			}
+		}
+
+		void DrawHeightField(const PxGeometryHolder& geometry, const PxTransform& pose)
+		{
+			std::vector<HeightFieldChunk>& chunks = height_field_meshes[HeightFieldKey(geometry.heightField())];
+			if (!chunks.size())
+				BuildHeightField(chunks, geometry.heightField());
+
+			//each chunk is tested against the view on its own
+			for (PxU32 i = 0; i < chunks.size(); i++)
+			{
+				render_stats.chunks_total++;
+				if (!frustum.IsVisible(PxBounds3::transformFast(pose, chunks[i].bounds)))
+				{
+					render_stats.chunks_culled++;
+					continue;
+				}
+				DrawMesh(chunks[i].mesh);
+			}
+		}
+
+		void RenderGeometry(const PxGeometryHolder& geometry, int detail, const PxTransform& pose)
 		{
 			switch(geometry.getType())
 			{
@@ -134,13 +550,13 @@ namespace VisualDebugger
 				DrawPlane();
 				break;
 			case PxGeometryType::eSPHERE:
-				DrawSphere(geometry);
+				DrawSphere(geometry, detail);
 				break;
 			case PxGeometryType::eBOX:			
 				DrawBox(geometry);
 				break;
 			case PxGeometryType::eCAPSULE:
-				DrawCapsule(geometry);
+				DrawCapsule(geometry, detail);
 				break;
 			case PxGeometryType::eCONVEXMESH:
 				DrawConvexMesh(geometry);
@@ -149,56 +565,209 @@ namespace VisualDebugger
 				DrawTriangleMesh(geometry);
 				break;
 			case PxGeometryType::eHEIGHTFIELD:
-				DrawHeightField(geometry);
+				DrawHeightField(geometry, pose);
 				break;
 			default:
 				break;
 			}
 		}
 
+		///Cross product of the xyz lanes, w of the result is 0
+		inline __m128 Cross(__m128 a, __m128 b)
+		{
+			__m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+			__m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+			__m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+			return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+		}
+
+		///Normalise a vector with w = 0
+		inline __m128 Normalize(__m128 v)
+		{
+			__m128 sq = _mm_mul_ps(v, v);
+			__m128 sum = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+			sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			return _mm_div_ps(v, _mm_sqrt_ps(_mm_max_ps(sum, _mm_set1_ps(1e-20f))));
+		}
+
+		///Worker threads kept alive between frames, the calling thread takes the first range of every job
+		class WorkerPool
+		{
+			std::vector<std::thread> threads;
+			std::mutex mutex;
+			std::condition_variable wake, done;
+			std::function<void(PxU32, PxU32)> job;
+			PxU32 count, step;
+			//incremented for every job, workers run each generation once
+			PxU32 generation;
+			//workers still running the current job
+			PxU32 pending;
+			bool stop;
+
+			void Work(PxU32 index)
+			{
+				PxU32 seen = 0;
+				std::unique_lock<std::mutex> lock(mutex);
+				for (;;)
+				{
+					wake.wait(lock, [&]() { return stop || (generation != seen); });
+					if (stop)
+						return;
+					seen = generation;
+
+					PxU32 begin = (index + 1)*step;
+					PxU32 end = PxMin(begin + step, count);
+					lock.unlock();
+					if (begin < end)
+						job(begin, end);
+					lock.lock();
+
+					if (--pending == 0)
+						done.notify_one();
+				}
+			}
+
+		public:
+			WorkerPool() : count(0), step(0), generation(0), pending(0), stop(false)
+			{
+				for (PxU32 i = 1; i < PxMax(std::thread::hardware_concurrency(), 1u); i++)
+					threads.push_back(std::thread(&WorkerPool::Work, this, i - 1));
+			}
+
+			~WorkerPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stop = true;
+				}
+				wake.notify_all();
+				for (PxU32 i = 0; i < threads.size(); i++)
+					threads[i].join();
+			}
+
+			PxU32 Size() { return (PxU32)threads.size() + 1; }
+
+			void Run(PxU32 _count, const std::function<void(PxU32, PxU32)>& _job)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					job = _job;
+					count = _count;
+					step = (count + Size() - 1) / Size();
+					pending = (PxU32)threads.size();
+					generation++;
+				}
+				wake.notify_all();
+
+				_job(0, PxMin(step, _count));
+
+				std::unique_lock<std::mutex> lock(mutex);
+				done.wait(lock, [&]() { return pending == 0; });
+			}
+		};
+
+		//created with the first large cloth
+		WorkerPool* workers = 0;
+
+		///Run func(begin, end) over [0, count), split across the worker threads when count is large enough
+		template<typename Func>
+		void ParallelFor(PxU32 count, PxU32 parallel_count, Func func)
+		{
+			if ((count < parallel_count) || (std::thread::hardware_concurrency() < 2))
+			{
+				func(0, count);
+				return;
+			}
+
+			if (!workers)
+				workers = new WorkerPool();
+			workers->Run(count, func);
+		}
+
+		///Build the particle to quad adjacency (the topology of a cloth doesn't change)
+		void BuildClothBuffer(ClothBuffer& buffer, PxU32 particle_count, const PxU32* quads, PxU32 quad_count)
+		{
+			buffer.particles.resize(particle_count);
+			buffer.normals.resize(particle_count);
+			buffer.quad_normals.resize(quad_count);
+
+			buffer.vertex_quad_start.assign(particle_count+1, 0);
+			for (PxU32 i = 0; i < quad_count*4; i++)
+				buffer.vertex_quad_start[quads[i]+1]++;
+			for (PxU32 i = 0; i < particle_count; i++)
+				buffer.vertex_quad_start[i+1] += buffer.vertex_quad_start[i];
+
+			std::vector<PxU32> fill(buffer.vertex_quad_start.begin(), buffer.vertex_quad_start.end()-1);
+			buffer.vertex_quads.resize(quad_count*4);
+			for (PxU32 i = 0; i < quad_count*4; i++)
+				buffer.vertex_quads[fill[quads[i]]++] = i/4;
+		}
+
 		void RenderCloth(const PxCloth* cloth)
 		{
-			PxClothMeshDesc* mesh_desc = ((UserData*)cloth->userData)->cloth_mesh_desc;
-			PxVec3* color = ((UserData*)cloth->userData)->color;
+			render_stats.shapes_total++;
+			if (!frustum.IsVisible(cloth->getWorldBounds()))
+			{
+				//keep the buffers of cloths that are only out of view
+				std::map<const PxCloth*, ClothBuffer>::iterator it = cloth_buffers.find(cloth);
+				if (it != cloth_buffers.end())
+					it->second.frame = frame;
+				render_stats.shapes_culled++;
+				return;
+			}
+
+			PxU32 row = RenderTable::Row(cloth->userData);
+			PxClothMeshDesc* mesh_desc = RenderTable::Get().cloth_mesh_desc[row];
+			const PxVec3& color = RenderTable::Get().color[row];
 
 			PxU32 quad_count = mesh_desc->quads.count;
 			PxU32* quads = (PxU32*)mesh_desc->quads.data;
+			PxU32 particle_count = cloth->getNbParticles();
 
-			std::vector<PxVec3> verts(cloth->getNbParticles());
-			std::vector<PxVec3> norms(verts.size(), PxVec3(0.f,0.f,0.f));
-
-			//get verts data
-			cloth->lockParticleData();
+			ClothBuffer& buffer = cloth_buffers[cloth];
+			buffer.frame = frame;
+			if ((buffer.particles.size() != particle_count) || (buffer.quad_normals.size() != quad_count))
+				BuildClothBuffer(buffer, particle_count, quads, quad_count);
 
+			//copy the particles in one go
 			PxClothParticleData* particle_data = cloth->lockParticleData();
 			if (!particle_data)
 				return;
-			// copy vertex positions
-			for (PxU32 j = 0; j < verts.size(); j++)
-				verts[j] = particle_data->particles[j].pos;
-
+			memcpy(&buffer.particles.front(), particle_data->particles, particle_count*sizeof(PxClothParticle));
 			particle_data->unlock();
 
-			for (PxU32 i = 0; i < quad_count*4; i+=4)
-			{
-				PxVec3 v0 = verts[quads[i]];
-				PxVec3 v1 = verts[quads[i+1]];
-				PxVec3 v2 = verts[quads[i+2]];
-				PxVec3 n = -((v1-v0).cross(v2-v0));
+			const float* particles = (const float*)&buffer.particles.front();
+			float* quad_normals = (float*)&buffer.quad_normals.front();
+			float* normals = (float*)&buffer.normals.front();
 
-				norms[quads[i]] += n;
-				norms[quads[i+1]] += n;
-				norms[quads[i+2]] += n;
-				norms[quads[i+3]] += n;
-			}
+			//quad normals
+			ParallelFor(quad_count, cloth_parallel_quads, [&](PxU32 begin, PxU32 end)
+			{
+				for (PxU32 i = begin; i < end; i++)
+				{
+					__m128 v0 = _mm_loadu_ps(particles + quads[i*4]*4);
+					__m128 v1 = _mm_loadu_ps(particles + quads[i*4+1]*4);
+					__m128 v2 = _mm_loadu_ps(particles + quads[i*4+2]*4);
+					_mm_storeu_ps(quad_normals + i*4, Cross(_mm_sub_ps(v2, v0), _mm_sub_ps(v1, v0)));
+				}
+			});
 
-			for (PxU32 i = 0; i < norms.size(); i++)
-				norms[i].normalize();
+			//particle normals: gather from the adjacent quads, so that threads never write to the same particle
+			ParallelFor(particle_count, cloth_parallel_quads, [&](PxU32 begin, PxU32 end)
+			{
+				for (PxU32 i = begin; i < end; i++)
+				{
+					__m128 n = _mm_setzero_ps();
+					for (PxU32 j = buffer.vertex_quad_start[i]; j < buffer.vertex_quad_start[i+1]; j++)
+						n = _mm_add_ps(n, _mm_loadu_ps(quad_normals + buffer.vertex_quads[j]*4));
+					_mm_storeu_ps(normals + i*4, Normalize(n));
+				}
+			});
 
 			PxTransform pose = cloth->getGlobalPose();
 			PxMat44 shapePose(pose);
 
-			glColor4f(color->x, color->y, color->z, 1.f);
+			glColor4f(color.x, color.y, color.z, 1.f);
 
 			glPushMatrix();						
 			glMultMatrixf((float*)&shapePose);
@@ -206,8 +775,8 @@ namespace VisualDebugger
 			glEnableClientState(GL_VERTEX_ARRAY);
 			glEnableClientState(GL_NORMAL_ARRAY);
 
-			glVertexPointer(3, GL_FLOAT, sizeof(PxVec3), &verts.front());
-			glNormalPointer(GL_FLOAT, sizeof(PxVec3), &norms.front());
+			glVertexPointer(3, GL_FLOAT, sizeof(PxClothParticle), &buffer.particles.front());
+			glNormalPointer(GL_FLOAT, sizeof(PxVec4), &buffer.normals.front());
 
 			glDrawElements(GL_QUADS, quad_count*4, GL_UNSIGNED_INT, quads);
 
@@ -267,6 +836,31 @@ namespace VisualDebugger
 			glEnable(GL_LIGHT0);
 		}
 
+		///Derive the view frustum from the camera and the perspective set in Start()
+		void UpdateFrustum(const PxVec3& eye, const PxVec3& dir, PxReal aspect)
+		{
+			PxVec3 d = dir.getNormalized();
+			PxVec3 right = d.cross(PxVec3(0.f, 1.f, 0.f));
+			//looking straight up or down, no culling
+			if (right.normalize() < 1e-6f)
+			{
+				frustum.valid = false;
+				return;
+			}
+			PxVec3 up = right.cross(d);
+
+			PxReal tan_y = PxTan(fov_y*0.5f*PxPi/180.f);
+			PxReal tan_x = tan_y*aspect;
+
+			frustum.planes[0] = PxPlane(eye + d*z_near, d);
+			frustum.planes[1] = PxPlane(eye + d*z_far, -d);
+			frustum.planes[2] = PxPlane(eye, (right + d*tan_x).getNormalized());
+			frustum.planes[3] = PxPlane(eye, (-right + d*tan_x).getNormalized());
+			frustum.planes[4] = PxPlane(eye, (up + d*tan_y).getNormalized());
+			frustum.planes[5] = PxPlane(eye, (-up + d*tan_y).getNormalized());
+			frustum.valid = true;
+		}
+
 		void Start(const PxVec3& cameraEye, const PxVec3& cameraDir)
 		{
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -274,11 +868,19 @@ namespace VisualDebugger
 			// Setup camera
 			glMatrixMode(GL_PROJECTION);
 			glLoadIdentity();
-			gluPerspective(60.f, (float)glutGet(GLUT_WINDOW_WIDTH)/(float)glutGet(GLUT_WINDOW_HEIGHT), 1.f, 10000.f);
+			PxReal aspect = (float)glutGet(GLUT_WINDOW_WIDTH)/(float)glutGet(GLUT_WINDOW_HEIGHT);
+			gluPerspective(fov_y, aspect, z_near, z_far);
 
 			glMatrixMode(GL_MODELVIEW);
 			glLoadIdentity();
 			gluLookAt(cameraEye.x, cameraEye.y, cameraEye.z, cameraEye.x + cameraDir.x, cameraEye.y + cameraDir.y, cameraEye.z + cameraDir.z, 0.f, 1.f, 0.f);
+
+			UpdateFrustum(cameraEye, cameraDir, aspect);
+			camera_eye = cameraEye;
+			viewport_height = (PxReal)glutGet(GLUT_WINDOW_HEIGHT);
+			lod_vertex_count = 0;
+
+			render_stats = RenderStats();
 		}
 
 		void BackgroundColor(const PxVec3& color)
@@ -286,78 +888,252 @@ namespace VisualDebugger
 			background_color = color;
 		}
 
-		void Render(PxActor** actors, const PxU32 numActors)
+		void RenderShape(const PxShape* shape, const PxVec3& shadow_color)
 		{
-			PxVec3 shadow_color = default_color*0.9;
-			for(PxU32 i=0;i<numActors;i++)
+			PxGeometryHolder h = shape->getGeometry();
+			RenderTable& table = RenderTable::Get();
+			PxU32 row = RenderTable::Row(shape->userData);
+			PxU8 flags = (row < table.Size()) ? table.flags[row] : 0;
+			render_stats.shapes_total++;
+
+			//sleeping shapes don't move, their pose and bounds are queried only once
+			PxTransform pose;
+			PxBounds3 bounds;
+			if ((flags & RenderTable::SLEEPING) && (flags & RenderTable::CACHED))
 			{
-				if (actors[i]->isCloth())
+				pose = table.pose[row];
+				bounds = table.bounds[row];
+				render_stats.shapes_sleeping++;
+			}
+			else
+			{
+				pose = PxShapeExt::getGlobalPose(*shape, *shape->getActor());
+				//planes are infinite, everything else is tested against the view (shadows included)
+				if (h.getType() != PxGeometryType::ePLANE)
+					bounds = PxShapeExt::getWorldBounds(*shape, *shape->getActor());
+				if (flags & RenderTable::SLEEPING)
 				{
-					RenderCloth((PxCloth*)actors[i]);
+					table.pose[row] = pose;
+					table.bounds[row] = bounds;
+					table.flags[row] |= RenderTable::CACHED;
 				}
-				else if (actors[i]->isRigidActor())
+			}
+
+			if ((h.getType() != PxGeometryType::ePLANE) && !frustum.IsVisible(bounds))
+			{
+				render_stats.shapes_culled++;
+				return;
+			}
+
+			//round shapes use a tessellation matching their size on the screen
+			int detail = render_detail;
+			if (h.getType() == PxGeometryType::eSPHERE)
+				detail = LodDetail(SelectLod(pose.p, h.sphere().radius, row));
+			else if (h.getType() == PxGeometryType::eCAPSULE)
+				detail = LodDetail(SelectLod(pose.p, h.capsule().radius + h.capsule().halfHeight, row));
+
+			//move the plane slightly down to avoid visual artefacts
+			if (h.getType() == PxGeometryType::ePLANE)
+			{
+				pose.q *= PxQuat(PxHalfPi, PxVec3(0.f, 0.f, 1.f));
+				pose.p += PxVec3(0,-0.01,0);
+			}
+
+			PxMat44 shapePose(pose);
+			// render object
+			glPushMatrix();						
+			glMultMatrixf((float*)&shapePose);
+
+			PxVec3 shape_color = default_color;
+
+			if (row < table.Size())
+				shape_color = table.color[row];
+
+			//selected actor
+			if (flags & RenderTable::HIGHLIGHT)
+				shape_color += PxVec3(.2f,.2f,.2f);
+
+			if (h.getType() == PxGeometryType::ePLANE)
+				glDisable(GL_LIGHTING);
+
+			glColor4f(shape_color.x, shape_color.y, shape_color.z, 1.f);
+
+			RenderGeometry(h, detail, pose);
+
+			if (h.getType() == PxGeometryType::ePLANE)
+				glEnable(GL_LIGHTING);
+
+			glPopMatrix();
+
+			//planes and heightfields are the ground, they don't cast shadows
+			if(show_shadows && (h.getType() != PxGeometryType::ePLANE) && (h.getType() != PxGeometryType::eHEIGHTFIELD))
+			{
+				glPushMatrix();						
+				glMultMatrixf(shadowMat);
+				glMultMatrixf((float*)&shapePose);
+				glDisable(GL_LIGHTING);
+				glColor4f(shadow_color.x, shadow_color.y, shadow_color.z, 1.f);
+				RenderGeometry(h, detail, pose);
+				glEnable(GL_LIGHTING);
+				glPopMatrix();
+			}
+		}
+
+		///Append a box to the static batch, transformed into world space
+		void BakeBox(const PxBoxGeometry& box, const PxTransform& pose, const PxVec3& color)
+		{
+			static const PxVec3 axes[3] = { PxVec3(1.f,0.f,0.f), PxVec3(0.f,1.f,0.f), PxVec3(0.f,0.f,1.f) };
+			static const PxU32 corner_order[6] = { 0, 1, 2, 0, 2, 3 };
+
+			for (PxU32 a = 0; a < 3; a++)
+			{
+				for (int s = -1; s <= 1; s += 2)
 				{
-					PxRigidActor* rigid_actor = (PxRigidActor*)actors[i];
-					std::vector<PxShape*> shapes(rigid_actor->getNbShapes());
-					rigid_actor->getShapes((PxShape**)&shapes.front(), (PxU32)shapes.size());
+					//face normal and two tangents, ordered so that the face winds CCW from outside
+					PxVec3 n = axes[a]*(PxReal)s;
+					PxVec3 u = axes[(a+1)%3];
+					PxVec3 v = axes[(a+2)%3]*(PxReal)s;
+					PxVec3 corners[4] = { n-u-v, n+u-v, n+u+v, n-u+v };
+					PxVec3 world_normal = pose.rotate(n);
+
+					for (PxU32 k = 0; k < 6; k++)
+					{
+						static_batch.verts.push_back(pose.transform(corners[corner_order[k]].multiply(box.halfExtents)));
+						static_batch.bounds.include(static_batch.verts.back());
+						static_batch.normals.push_back(world_normal);
+						static_batch.colors.push_back(color);
+					}
+				}
+			}
+		}
 
-					for(PxU32 j = 0; j < shapes.size(); j++)
+		void BuildStaticBatch(PxActor** actors, const PxU32 numActors)
+		{
+			static_batch.verts.clear();
+			static_batch.normals.clear();
+			static_batch.colors.clear();
+			static_batch.shapes.clear();
+			static_batch.shadow_color = default_color*0.9;
+			static_batch.bounds = PxBounds3::empty();
+
+			for (PxU32 i = 0; i < numActors; i++)
+			{
+				if (!actors[i]->isRigidStatic())
+					continue;
+
+				PxRigidActor* rigid_actor = (PxRigidActor*)actors[i];
+				std::vector<PxShape*> shapes(rigid_actor->getNbShapes());
+				rigid_actor->getShapes((PxShape**)&shapes.front(), (PxU32)shapes.size());
+
+				for (PxU32 j = 0; j < shapes.size(); j++)
+				{
+					const PxShape* shape = shapes[j];
+					PxVec3 shape_color = default_color;
+					PxU32 row = RenderTable::Row(shape->userData);
+					if (row < RenderTable::Get().Size())
+						shape_color = RenderTable::Get().color[row];
+
+					PxGeometryHolder h = shape->getGeometry();
+					if (h.getType() == PxGeometryType::eBOX)
+					{
+						BakeBox(h.box(), PxShapeExt::getGlobalPose(*shape, *rigid_actor), shape_color);
+					}
+					else
 					{
-						const PxShape* shape = shapes[j];
-						PxTransform pose = PxShapeExt::getGlobalPose(*shape, *shape->getActor());
-						PxGeometryHolder h = shape->getGeometry();
-						//move the plane slightly down to avoid visual artefacts
+						//planes and other geometry types are kept on the per-shape path
 						if (h.getType() == PxGeometryType::ePLANE)
-						{
-							pose.q *= PxQuat(PxHalfPi, PxVec3(0.f, 0.f, 1.f));
-							pose.p += PxVec3(0,-0.01,0);
-						}
+							static_batch.shadow_color = shape_color*0.9;
+						static_batch.shapes.push_back(shape);
+					}
+				}
+			}
 
-						PxMat44 shapePose(pose);
-						// render object
-						glPushMatrix();						
-						glMultMatrixf((float*)&shapePose);
+			static_batch.valid = true;
+		}
 
-						PxVec3 shape_color = default_color;
+		void DrawStaticBatch()
+		{
+			if (!static_batch.verts.size())
+				return;
 
-						if (shape->userData)
-						{
-							shape_color = *(((UserData*)shape->userData)->color);
-							if (h.getType() == PxGeometryType::ePLANE)
-							{
-								shadow_color = shape_color*0.9;
-							}
-						}
+			render_stats.shapes_total++;
+			if (!frustum.IsVisible(static_batch.bounds))
+			{
+				render_stats.shapes_culled++;
+				return;
+			}
 
-						if (h.getType() == PxGeometryType::ePLANE)
-							glDisable(GL_LIGHTING);
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glEnableClientState(GL_COLOR_ARRAY);
+			glVertexPointer(3, GL_FLOAT, sizeof(PxVec3), &static_batch.verts.front());
+			glNormalPointer(GL_FLOAT, sizeof(PxVec3), &static_batch.normals.front());
+			glColorPointer(3, GL_FLOAT, sizeof(PxVec3), &static_batch.colors.front());
+			glDrawArrays(GL_TRIANGLES, 0, (GLsizei)static_batch.verts.size());
+			glDisableClientState(GL_COLOR_ARRAY);
+			glDisableClientState(GL_NORMAL_ARRAY);
 
-						glColor4f(shape_color.x, shape_color.y, shape_color.z, 1.f);
+			if (show_shadows)
+			{
+				//the batch is already in world space, so only the projection is needed
+				glPushMatrix();
+				glMultMatrixf(shadowMat);
+				glDisable(GL_LIGHTING);
+				glColor4f(static_batch.shadow_color.x, static_batch.shadow_color.y, static_batch.shadow_color.z, 1.f);
+				glDrawArrays(GL_TRIANGLES, 0, (GLsizei)static_batch.verts.size());
+				glEnable(GL_LIGHTING);
+				glPopMatrix();
+			}
 
-						RenderGeometry(h);
+			glDisableClientState(GL_VERTEX_ARRAY);
+		}
 
-						if (h.getType() == PxGeometryType::ePLANE)
-							glEnable(GL_LIGHTING);
+		void Render(PxActor** actors, const PxU32 numActors)
+		{
+			PxVec3 shadow_color = static_batch.shadow_color;
 
-						glPopMatrix();
+			if (static_batch.valid)
+			{
+				for (PxU32 i = 0; i < static_batch.shapes.size(); i++)
+					RenderShape(static_batch.shapes[i], shadow_color);
+				DrawStaticBatch();
+			}
 
-						if(show_shadows && (h.getType() != PxGeometryType::ePLANE))
-						{
-							const PxVec3 shadowDir(-0.7071067f, -0.7071067f, -0.7071067f);
-							const PxReal shadowMat[]={ 1,0,0,0, -shadowDir.x/shadowDir.y,0,-shadowDir.z/shadowDir.y,0, 0,0,1,0, 0,0,0,1 };
-							glPushMatrix();						
-							glMultMatrixf(shadowMat);
-							glMultMatrixf((float*)&shapePose);
-							glDisable(GL_LIGHTING);
-							glColor4f(shadow_color.x, shadow_color.y, shadow_color.z, 1.f);
-							RenderGeometry(h);
-							glEnable(GL_LIGHTING);
-							glPopMatrix();
-						}
+			for(PxU32 i=0;i<numActors;i++)
+			{
+				if (actors[i]->isCloth())
+				{
+					RenderCloth((PxCloth*)actors[i]);
+				}
+				else if (actors[i]->isRigidActor())
+				{
+					//static actors are drawn by the batch
+					if (static_batch.valid && actors[i]->isRigidStatic())
+						continue;
+
+					PxRigidActor* rigid_actor = (PxRigidActor*)actors[i];
+					std::vector<PxShape*> shapes(rigid_actor->getNbShapes());
+					rigid_actor->getShapes((PxShape**)&shapes.front(), (PxU32)shapes.size());
+
+					for(PxU32 j = 0; j < shapes.size(); j++)
+					{
+						PxU32 row = RenderTable::Row(shapes[j]->userData);
+						if (!static_batch.valid && (shapes[j]->getGeometryType() == PxGeometryType::ePLANE) && (row < RenderTable::Get().Size()))
+							shadow_color = RenderTable::Get().color[row]*0.9;
+						RenderShape(shapes[j], shadow_color);
 					}
 				}
+			}
 
+			//drop the buffers of cloths that are gone
+			for (std::map<const PxCloth*, ClothBuffer>::iterator it = cloth_buffers.begin(); it != cloth_buffers.end();)
+			{
+				if (it->second.frame != frame)
+					it = cloth_buffers.erase(it);
+				else
+					++it;
 			}
+			frame++;
 		}
 
 		void Finish()
@@ -368,6 +1144,8 @@ namespace VisualDebugger
 		void SetRenderDetail(int value)
 		{
 			render_detail = value;
+			sphere_meshes.clear();
+			capsule_meshes.clear();
 		}
 
 		void ShowShadows(bool value)
@@ -377,6 +1155,23 @@ namespace VisualDebugger
 
 		bool ShowShadows() { return show_shadows; }
 
+		void ClearMeshCache()
+		{
+			triangle_meshes.clear();
+			convex_meshes.clear();
+			height_field_meshes.clear();
+			cloth_buffers.clear();
+		}
+
+		void Release()
+		{
+			ClearMeshCache();
+			delete workers;
+			workers = 0;
+		}
+
+		const RenderStats& GetRenderStats() { return render_stats; }
+
 		void RenderBuffer(float* pVertList, float* pColorList, int type, int num)
 		{
 			glEnableClientState(GL_VERTEX_ARRAY);
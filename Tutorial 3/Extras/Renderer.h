@@ -11,6 +11,22 @@ namespace VisualDebugger
 	{
 		using namespace physx;
 
+		///Per-frame render statistics
+		struct RenderStats
+		{
+			//shapes (and batches) submitted to the renderer
+			PxU32 shapes_total;
+			//shapes skipped by the view frustum test
+			PxU32 shapes_culled;
+			//shapes of sleeping actors drawn from their cached pose
+			PxU32 shapes_sleeping;
+			//heightfield chunks in the visible heightfields, and those culled
+			PxU32 chunks_total;
+			PxU32 chunks_culled;
+
+			RenderStats() : shapes_total(0), shapes_culled(0), shapes_sleeping(0), chunks_total(0), chunks_culled(0) {}
+		};
+
 		///Init rendering window
 		void InitWindow(const char *name, int width, int height);
 
@@ -23,6 +39,10 @@ namespace VisualDebugger
 		///Render actors
 		void Render(PxActor** actors, const PxU32 numActors);
 
+		///Bake all static actors into a single world-space batch.
+		///Call again whenever a static actor is added or removed.
+		void BuildStaticBatch(PxActor** actors, const PxU32 numActors);
+
 		///Render debug information
 		void Render(const PxRenderBuffer& data, PxReal line_width=1.f);
 
@@ -37,6 +57,7 @@ namespace VisualDebugger
 		void Finish();
 
 		///Set rendering detail for spheres and capsules.
+		///This is the finest level, smaller shapes on the screen use coarser ones.
 		void SetRenderDetail(int value);
 
 		///Set show shadows
@@ -44,5 +65,15 @@ namespace VisualDebugger
 
 		///Get show shadows
 		bool ShowShadows();
+
+		///Drop the render buffers built from cooked meshes, heightfields and cloths.
+		///Call after releasing meshes that were drawn before (e.g. when the scene is reset), the buffers are keyed by their addresses.
+		void ClearMeshCache();
+
+		///Drop all cached buffers and stop the worker threads (call before exit)
+		void Release();
+
+		///Get the statistics of the last rendered frame
+		const RenderStats& GetRenderStats();
 	}
 }
\ No newline at end of file
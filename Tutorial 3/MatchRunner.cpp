@@ -0,0 +1,120 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include "MatchRunner.h"
+#include "MyPhysicsEngine.h"
+
+namespace MatchRunner
+{
+	using namespace std;
+	using namespace PhysicsEngine;
+
+	//same step and forces as the interactive game
+	static const PxReal time_step = 1.f / 120.f;
+	static const PxReal force_strength = 200.f;
+	//a match without a winner is stopped after 2 minutes
+	static const PxU32 max_steps = (PxU32)(120.f / time_step);
+
+	//PhysX objects are created one scene at a time, the simulation itself runs in parallel
+	static mutex init_mutex;
+
+	///Play a single match to the end (or until the time runs out)
+	static MatchResult Play(PxU32 seed)
+	{
+		MyScene* scene = new MyScene();
+		{
+			lock_guard<mutex> lock(init_mutex);
+			//each match runs on a single pool thread, the scene doesn't need its own workers
+			scene->WorkerThreads(0);
+			scene->Init();
+		}
+
+		PxRigidDynamic* ball = (PxRigidDynamic*)scene->sphere->Get();
+
+		//kick-off in a random direction
+		mt19937 random(seed);
+		uniform_real_distribution<PxReal> angle(0.f, PxTwoPi);
+		PxReal kick = angle(random);
+		//as an impulse, so that the kick doesn't depend on the substeps of the first step
+		ball->addForce(PxVec3(PxCos(kick), 0.f, PxSin(kick))*force_strength*time_step, PxForceMode::eIMPULSE);
+
+		MatchResult result;
+		for (result.steps = 0; (result.steps < max_steps) && !scene->gameOver; result.steps++)
+		{
+			//simple bots chasing the ball
+			scene->controllers[0]->PushTowards(ball->getGlobalPose().p);
+			scene->controllers[1]->PushTowards(ball->getGlobalPose().p);
+			scene->Update(time_step);
+		}
+
+		result.scorePlayer1 = scene->scorePlayer1;
+		result.scorePlayer2 = scene->scorePlayer2;
+
+		{
+			lock_guard<mutex> lock(init_mutex);
+			scene->Release();
+			delete scene;
+		}
+
+		return result;
+	}
+
+	vector<MatchResult> Run(PxU32 matches, PxU32 threads)
+	{
+		vector<MatchResult> results(matches);
+		atomic<PxU32> next_match(0);
+
+		//every thread keeps taking the next match until all have been played
+		vector<thread> pool;
+		for (PxU32 i = 0; i < PxMax(threads, (PxU32)1); i++)
+		{
+			pool.push_back(thread([&]()
+			{
+				for (PxU32 match = next_match++; match < matches; match = next_match++)
+					results[match] = Play(match);
+			}));
+		}
+
+		for (unsigned int i = 0; i < pool.size(); i++)
+			pool[i].join();
+
+		return results;
+	}
+
+	void Report(PxU32 matches)
+	{
+		PxU32 cores = PxMax(thread::hardware_concurrency(), 1u);
+
+		cout << matches << " matches, " << cores << " cores" << endl;
+		cout << setw(8) << "threads" << " | " << setw(12) << "matches/s" << setw(10) << "steps/s"
+			<< setw(8) << "P1 won" << setw(8) << "P2 won" << setw(8) << "draws" << endl;
+
+		for (PxU32 threads = 1; ; threads = PxMin(threads*2, cores))
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			vector<MatchResult> results = Run(matches, threads);
+			chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+
+			PxU32 won1 = 0, won2 = 0;
+			double steps = 0.;
+			for (unsigned int i = 0; i < results.size(); i++)
+			{
+				if (results[i].scorePlayer1 > results[i].scorePlayer2)
+					won1++;
+				else if (results[i].scorePlayer2 > results[i].scorePlayer1)
+					won2++;
+				steps += results[i].steps;
+			}
+
+			cout << setw(8) << threads << " | " << setw(12) << fixed << setprecision(2) << matches / elapsed.count()
+				<< setw(10) << (PxU32)(steps / elapsed.count()) << setw(8) << won1 << setw(8) << won2 << setw(8) << (matches - won1 - won2) << endl;
+
+			if (threads == cores)
+				break;
+		}
+	}
+}
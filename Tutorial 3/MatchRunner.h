@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include "PxPhysicsAPI.h"
+
+namespace MatchRunner
+{
+	using namespace physx;
+
+	///Outcome of a single match
+	struct MatchResult
+	{
+		int scorePlayer1, scorePlayer2;
+		//simulation steps played
+		PxU32 steps;
+	};
+
+	///Play a number of matches, each in its own scene, on a pool of threads
+	///(expects PxInit to be called before)
+	std::vector<MatchResult> Run(PxU32 matches, PxU32 threads);
+
+	///Play the same batch of matches with an increasing number of threads and print the throughput
+	void Report(PxU32 matches);
+}
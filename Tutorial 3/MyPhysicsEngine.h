@@ -3,6 +3,7 @@
 #include "BasicActors.h"
 #include <iostream>
 #include <iomanip>
+#include <functional>
 
 namespace PhysicsEngine
 {
@@ -16,10 +17,64 @@ namespace PhysicsEngine
 	{
 		enum Enum
 		{
-			Sphere = (1 << 0),
-			GoalPlayer1 = (1 << 1),
-			GoalPlayer2 = (1 << 2)
+			//shapes without a group (the ice, anchors)
+			Default = (1 << 0),
+			Sphere = (1 << 1),
+			GoalPlayer1 = (1 << 2),
+			GoalPlayer2 = (1 << 3),
+			Player = (1 << 4),
+			Boundary = (1 << 5),
+			Obstacle = (1 << 6),
+			ObstacleTrigger = (1 << 7),
+			//jointed props: flipper, motor arms, trampoline
+			Mover = (1 << 8)
 		};
+
+		static const PxU32 Count = 9;
+	};
+
+	namespace detail
+	{
+		//shorthands for the pair policy table, kept out of PhysicsEngine
+		static const PxU8 K = PairPolicy::Kill;
+		static const PxU8 C = PairPolicy::Contact;
+		//the ball is swept against everything it can pass through (the ice, the goals)
+		static const PxU8 S = PairPolicy::Contact | PairPolicy::CCD;
+		//goals only need to know the ball touched them, a fast shot must not tunnel through without the report
+		static const PxU8 R = PairPolicy::Contact | PairPolicy::ReportTouch | PairPolicy::CCD;
+		//the ball is swept and reports hard hits (over the contact report threshold of the ball)
+		static const PxU8 H = PairPolicy::Contact | PairPolicy::CCD | PairPolicy::ReportForce;
+		static const PxU8 T = PairPolicy::Trigger;
+
+		///What happens between every two filter groups, in the order of FilterGroup (must be symmetric)
+		static constexpr PxU8 pair_policy[FilterGroup::Count][FilterGroup::Count] = {
+			//Default Sphere  Goal1   Goal2   Player  Bound.  Obst.   ObstTr. Mover
+			{ C,      S,      C,      C,      C,      C,      C,      K,      C },	//Default
+			{ S,      C,      R,      R,      H,      H,      H,      K,      H },	//Sphere
+			{ C,      R,      K,      K,      C,      K,      C,      K,      C },	//GoalPlayer1
+			{ C,      R,      K,      K,      C,      K,      C,      K,      C },	//GoalPlayer2
+			{ C,      H,      C,      C,      C,      C,      C,      K,      C },	//Player
+			{ C,      H,      K,      K,      C,      K,      C,      K,      C },	//Boundary
+			{ C,      H,      C,      C,      C,      C,      C,      T,      C },	//Obstacle
+			{ K,      K,      K,      K,      K,      K,      T,      K,      K },	//ObstacleTrigger
+			{ C,      H,      C,      C,      C,      C,      C,      K,      C } };	//Mover
+	}
+
+	constexpr bool PairPolicySymmetric(PxU32 i = 0, PxU32 j = 0)
+	{
+		return (i == FilterGroup::Count) ? true :
+			(j == FilterGroup::Count) ? PairPolicySymmetric(i + 1, 0) :
+			(detail::pair_policy[i][j] == detail::pair_policy[j][i]) && PairPolicySymmetric(i, j + 1);
+	}
+
+	static_assert(PairPolicySymmetric(), "pair_policy has to be symmetric");
+
+	///Pair policy table of the game for TableFilterShader
+	struct GamePairPolicy
+	{
+		static const PxU32 Count = FilterGroup::Count;
+
+		static PxU32 Policy(PxU32 group0, PxU32 group1) { return detail::pair_policy[group0][group1]; }
 	};
 
 	///An example class showing the use of springs (distance joints).
@@ -28,6 +83,8 @@ namespace PhysicsEngine
 		vector<DistanceJoint*> springs;
 		Boxes *bottom, *top;
 		Box* box;
+		D6Joint* anchor;
+		Aggregate* parts;
 
 	public:
 			bool x, y, z;
@@ -38,6 +95,8 @@ namespace PhysicsEngine
 			top = new Boxes(PxTransform(PxVec3(position), PxQuat((PxPi / 2), PxVec3(0.f, 0.f, 1.f))), PxVec3(dimensions.x, thickness, dimensions.z));
 			bottom = new Boxes(PxTransform(PxVec3(position), PxQuat((PxPi / 2), PxVec3(0.f, 0.f, 1.f))), PxVec3(dimensions.x, thickness, dimensions.z));
 			box = new Box();
+			anchor = 0;
+			parts = 0;
 			springs.resize(4);
 			springs[0] = new DistanceJoint(bottom, PxTransform(PxVec3(dimensions.x, thickness, dimensions.z)), top, PxTransform(PxVec3(dimensions.x, -dimensions.y, dimensions.z)));
 			springs[1] = new DistanceJoint(bottom, PxTransform(PxVec3(dimensions.x, thickness, -dimensions.z)), top, PxTransform(PxVec3(dimensions.x, -dimensions.y, -dimensions.z)));
@@ -49,36 +108,205 @@ namespace PhysicsEngine
 				springs[i]->Stiffness(stiffness);
 				springs[i]->Damping(damping);
 			}
+
+			//springs need more solver iterations to stay stable
+			bottom->Solver(solver_jointed);
+			top->Solver(solver_jointed);
+			bottom->SetupFiltering(FilterGroup::Mover, 0);
+			top->SetupFiltering(FilterGroup::Mover, 0);
 		}
 
 		void AddToScene(Scene* scene)
 		{
-			scene->Add(bottom);
-			scene->Add(top);
+			//the boards are held together by the springs and never need to collide with each other,
+			//the static anchor doesn't move and gains nothing from the aggregate
+			parts = new Aggregate(2);
+			parts->Add(bottom);
+			parts->Add(top);
+			scene->Add(parts);
 			scene->Add(box);
 			top->GetShape(0)->setLocalPose(PxTransform(PxVec3(2.f, 0.5f, 0.0f), PxQuat((PxPi / 2), PxVec3(0.f, 0.f, 1.f))));
 			bottom->GetShape(0)->setLocalPose(PxTransform(PxVec3(-0.f, 1.5f, 0.0f), PxQuat((PxPi / 2), PxVec3(0.f, 0.f, 1.f))));
 			box->GetShape(0)->getActor()->setGlobalPose(PxTransform(PxVec3(-63.f, 0.5f, -20.5f)));
-			D6Joint* trampolineJoint = new D6Joint(box, PxTransform(PxVec3(2.f, 0.5f, 0.0f)), bottom, PxTransform(PxVec3(-2.f, 0.0f, 0.0f), PxQuat(PxPi/4.25, PxVec3(0.f, 1.f, 0.f))), x = false, y = false, z = false);
+			anchor = new D6Joint(box, PxTransform(PxVec3(2.f, 0.5f, 0.0f)), bottom, PxTransform(PxVec3(-2.f, 0.0f, 0.0f), PxQuat(PxPi/4.25, PxVec3(0.f, 1.f, 0.f))), x = false, y = false, z = false);
 		}
 
 		~Trampoline()
 		{
 			for (unsigned int i = 0; i < springs.size(); i++)
 				delete springs[i];
+			delete anchor;
+			delete parts;
+			delete bottom;
+			delete top;
+			delete box;
+		}
+	};
+
+	///Drives a player: movement intent from all sources is summed up and applied once per simulation step
+	///A dynamic player is pushed with a force, a kinematic one is moved to a target integrated from the same force
+	class PlayerController
+	{
+		PxRigidDynamic* body;
+		//sum of the pushes requested for the next step
+		PxVec3 intent;
+		//pushes of the current step, applied on each of its substeps
+		PxVec3 step_intent;
+		PxReal force;
+		PxReal max_speed;
+		//kinematic mode: own velocity, the area the player is kept in, the target of the substep and the half size of the box
+		bool kinematic;
+		PxVec3 velocity;
+		PxBounds3 area;
+		PxTransform target;
+		PxVec3 half_extents;
+
+		void ClampSpeed(PxVec3& v)
+		{
+			PxReal speed = v.magnitude();
+			if (speed > max_speed)
+				v *= max_speed / speed;
+		}
+
+		//stop the target at the boundaries of the area
+		void ClampTarget()
+		{
+			for (PxU32 i = 0; i < 3; i++)
+			{
+				if ((target.p[i] < area.minimum[i]) || (target.p[i] > area.maximum[i]))
+				{
+					target.p[i] = PxClamp(target.p[i], area.minimum[i], area.maximum[i]);
+					velocity[i] = 0.f;
+				}
+			}
+		}
+
+	public:
+		PlayerController(Player* player, PxReal _force = 200.f, PxReal _max_speed = 20.f)
+			: body((PxRigidDynamic*)player->Get()), intent(0.f, 0.f, 0.f), step_intent(0.f, 0.f, 0.f), force(_force), max_speed(_max_speed),
+			kinematic(false), velocity(0.f, 0.f, 0.f), target(PxIdentity), half_extents(0.f, 0.f, 0.f)
+		{
+		}
+
+		///Drive the player as a kinematic body kept inside the area (bounds of its centre)
+		void Kinematic(const PxBounds3& _area)
+		{
+			kinematic = true;
+			area = _area;
+			target = body->getGlobalPose();
+			body->setRigidDynamicFlag(PxRigidDynamicFlag::eKINEMATIC, true);
+
+			//the players are axis aligned boxes, used to keep two kinematic players apart
+			PxShape* shape = 0;
+			PxBoxGeometry box;
+			if (body->getShapes(&shape, 1) && shape->getBoxGeometry(box))
+				half_extents = box.halfExtents;
+		}
+
+		///Request a push for the next step (a unit direction gives the full force)
+		void Push(const PxVec3& direction)
+		{
+			intent += direction;
+		}
+
+		///Take the accumulated intent for the current step, called once per step
+		void BeginStep()
+		{
+			step_intent = intent;
+			intent = PxVec3(0.f, 0.f, 0.f);
+		}
+
+		///Apply the intent of the current step, called before every simulate (dt - length of the substep)
+		void Apply(PxReal dt)
+		{
+			PxVec3 intent = step_intent;
+
+			if (kinematic)
+			{
+				target = body->getGlobalPose();
+
+				//nothing to do for a resting player
+				if (intent.isZero() && velocity.isZero())
+					return;
+
+				velocity += intent*(force / body->getMass()*dt);
+				ClampSpeed(velocity);
+
+				target.p += velocity*dt;
+				ClampTarget();
+
+				body->setKinematicTarget(target);
+			}
+			//a dynamic player without input is left alone, so that it can fall asleep
+			else if (!intent.isZero())
+			{
+				//keep the player below its top speed
+				PxVec3 v = body->getLinearVelocity();
+				if (v.magnitudeSquared() > max_speed*max_speed)
+				{
+					ClampSpeed(v);
+					body->setLinearVelocity(v);
+				}
+
+				body->addForce(intent*force);
+			}
+		}
+
+		///Push the player towards a point on the ice
+		void PushTowards(const PxVec3& point)
+		{
+			PxVec3 direction = point - body->getGlobalPose().p;
+			direction.y = 0.f;
+			if (direction.normalize() > 0.f)
+				Push(direction);
+		}
+
+		///Keep two kinematic players from moving into each other, called after Apply on every substep
+		///PhysX doesn't create contacts between kinematic bodies, so the targets are separated here along the axis of the smaller overlap
+		static void Separate(PlayerController& a, PlayerController& b)
+		{
+			if (!a.kinematic || !b.kinematic)
+				return;
+
+			PxVec3 d = b.target.p - a.target.p;
+			PxVec3 overlap = a.half_extents + b.half_extents - PxVec3(PxAbs(d.x), PxAbs(d.y), PxAbs(d.z));
+			if ((overlap.x <= 0.f) || (overlap.y <= 0.f) || (overlap.z <= 0.f))
+				return;
+
+			PxU32 axis = (overlap.x < overlap.z) ? 0 : 2;
+			PxReal side = (d[axis] < 0.f) ? -1.f : 1.f;
+
+			//each gives way by half, b takes the rest when a is stopped by the area
+			a.target.p[axis] -= side*.5f*overlap[axis];
+			a.ClampTarget();
+			b.target.p[axis] = a.target.p[axis] + side*(a.half_extents[axis] + b.half_extents[axis]);
+			b.ClampTarget();
+			a.velocity[axis] = b.velocity[axis] = 0.f;
+
+			a.body->setKinematicTarget(a.target);
+			b.body->setKinematicTarget(b.target);
 		}
+
+		///Forget the intent and the speed (e.g. after the player was moved)
+		void Stop()
+		{
+			intent = step_intent = velocity = PxVec3(0.f, 0.f, 0.f);
+		}
+
+		PxRigidDynamic* Get() { return body; }
 	};
 
 	///A customised collision class, implemneting various callbacks
 	class MySimulationEventCallback : public PxSimulationEventCallback
 	{
 	public:
-		//MyScene* myscene;
+		//scene that keeps track of the sleeping actors
+		Scene* scene;
 		//an example variable that will be checked in the main simulation loop
 		bool isOver = false, trigger, gameOver = false, direction = false; 
 		int scorePlayer1 = 0, scorePlayer2 = 0;
 
-		MySimulationEventCallback() : trigger(false) {}
+		MySimulationEventCallback(Scene* _scene) : scene(_scene), trigger(false) {}
 
 		///Method called when the contact with the trigger object is detected.
 		virtual void onTrigger(PxTriggerPair* pairs, PxU32 count)
@@ -99,12 +327,10 @@ namespace PhysicsEngine
 							if (pairs[i].triggerActor->getName() == obstacleTrigger)
 							{
 								direction = true;
-								cout << "Obstacle collided with trigger, changing direction" << endl;
 							}
 							if (pairs[i].triggerActor->getName() == obstacleTrigger2)
 							{
 								direction = false;
-								cout << "Obstacle collided with trigger, changing direction" << endl;
 							}
 						}
 					}
@@ -113,41 +339,42 @@ namespace PhysicsEngine
 		}
 
 		///Method called when the contact by the filter shader is detected.
+		///Only the pairs asked for by the pair policy table get here: touches of the goals and hard hits of the ball.
 		virtual void onContact(const PxContactPairHeader &pairHeader, const PxContactPair *pairs, PxU32 nbPairs)
 		{
-			string goal1 = "Goal1", goal2 = "Goal2";
-			cerr << "Contact found between " << pairHeader.actors[0]->getName() << " " << pairHeader.actors[1]->getName() << endl;
-
-			//check all pairs
 			for (PxU32 i = 0; i < nbPairs; i++)
 			{
-				//check eNOTIFY_TOUCH_FOUND
+				//skip the pairs of removed shapes
+				if ((pairs[i].flags & PxContactPairFlag::eREMOVED_SHAPE_0) || (pairs[i].flags & PxContactPairFlag::eREMOVED_SHAPE_1))
+					continue;
+
 				if (pairs[i].events & PxPairFlag::eNOTIFY_TOUCH_FOUND)
 				{
-					if (pairHeader.actors[1]->getName() == goal1)
-					{
+					PxU32 groups = pairs[i].shapes[0]->getSimulationFilterData().word0 | pairs[i].shapes[1]->getSimulationFilterData().word0;
+					//the ball in the goal of player 1 scores for player 2 and the other way around
+					if (groups & FilterGroup::GoalPlayer1)
 						scorePlayer2++;
-						//cerr << "onContact::eNOTIFY_TOUCH_FOUND TRIGGER 1" << endl;
-					}
-					if (pairHeader.actors[1]->getName() == goal2)
-					{
+					if (groups & FilterGroup::GoalPlayer2)
 						scorePlayer1++;
-						//cerr << "onContact::eNOTIFY_TOUCH_FOUND TRIGGER 2" << endl;
-					}
+					if (scorePlayer1 >= 1 || scorePlayer2 >= 1)
+						isOver = true;
 				}
-				//check eNOTIFY_TOUCH_LOST
-				if (pairs[i].events & PxPairFlag::eNOTIFY_TOUCH_LOST)
-				{
-					cerr << "onContact::eNOTIFY_TOUCH_LOST" << endl;
-				}
-				if (scorePlayer1 >= 1 || scorePlayer2 >= 1)
+
+				if (pairs[i].events & PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND)
 				{
-					isOver = true;
+					for (unsigned int j = 0; j < hard_hits.size(); j++)
+						hard_hits[j](pairHeader.actors[0], pairHeader.actors[1]);
 				}
 			}
 			endGame();
 		}
 
+		///Subscribe to hard hits - contacts over the contact report threshold of a dynamic actor
+		void OnHardHit(const function<void(PxRigidActor*, PxRigidActor*)>& listener)
+		{
+			hard_hits.push_back(listener);
+		}
+
 		void endGame()
 		{
 			if (scorePlayer1 >= 5 || scorePlayer2 >= 5)
@@ -157,36 +384,11 @@ namespace PhysicsEngine
 		}
 
 		virtual void onConstraintBreak(PxConstraintInfo *constraints, PxU32 count) {}
-		virtual void onWake(PxActor **actors, PxU32 count) {}
-		virtual void onSleep(PxActor **actors, PxU32 count) {}
-	};
-
-	//A simple filter shader based on PxDefaultSimulationFilterShader - without group filtering
-	static PxFilterFlags CustomFilterShader(PxFilterObjectAttributes attributes0, PxFilterData filterData0,
-		PxFilterObjectAttributes attributes1, PxFilterData filterData1,
-		PxPairFlags& pairFlags, const void* constantBlock, PxU32 constantBlockSize)
-	{
-		// let triggers through
-		if (PxFilterObjectIsTrigger(attributes0) || PxFilterObjectIsTrigger(attributes1))
-		{
-			pairFlags = PxPairFlag::eTRIGGER_DEFAULT;
-			return PxFilterFlags();
-		}
+		virtual void onWake(PxActor **actors, PxU32 count) { scene->OnWake(actors, count); }
+		virtual void onSleep(PxActor **actors, PxU32 count) { scene->OnSleep(actors, count); }
 
-		pairFlags = PxPairFlag::eCONTACT_DEFAULT;
-
-
-			// trigger the contact callback for pairs (A,B) where 
-			// the filtermask of A contains the ID of B and vice versa.
-		if ((filterData0.word0 & filterData1.word1) && (filterData1.word0 & filterData0.word1))
-		{
-			//trigger onContact callback for this pair of objects
-			pairFlags |= PxPairFlag::eNOTIFY_TOUCH_FOUND;
-			pairFlags |= PxPairFlag::eNOTIFY_TOUCH_LOST;
-			//			pairFlags |= PxPairFlag::eNOTIFY_CONTACT_POINTS;
-		}
-
-		return PxFilterFlags();
+	private:
+		vector<function<void(PxRigidActor*, PxRigidActor*)>> hard_hits;
 	};
 
 	///Custom scene class
@@ -203,19 +405,69 @@ namespace PhysicsEngine
 		Goals* goalTrigger1, *goalTrigger2;
 		MotorArms* motorArms;
 		bool x, y, z;
+		//everything else created by CustomInit, released by CustomRelease
+		vector<Joint*> joints;
+		vector<Aggregate*> aggregates;
+		vector<Actor*> actors;
+		Trampoline* trampoline;
 
 	public:
 
-		MyScene() : Scene() { filter_shader = CustomFilterShader; };
+		MyScene() : Scene(), my_callback(0), trampoline(0) { filter_shader = TableFilterShader<GamePairPolicy>; controllers[0] = controllers[1] = 0; };
+
+		~MyScene()
+		{
+			CustomRelease();
+			delete my_callback;
+			delete controllers[0];
+			delete controllers[1];
+		}
+
+		//release the joints first, then the groups and finally the actors
+		virtual void CustomRelease()
+		{
+			for (unsigned int i = 0; i < joints.size(); i++)
+				delete joints[i];
+			joints.clear();
+
+			delete trampoline;
+			trampoline = 0;
+
+			for (unsigned int i = 0; i < aggregates.size(); i++)
+				delete aggregates[i];
+			aggregates.clear();
+
+			for (unsigned int i = 0; i < actors.size(); i++)
+				delete actors[i];
+			actors.clear();
+		}
+
+		//movement controllers of player 1 and player 2
+		PlayerController* controllers[2];
+		//force pushing the players
+		PxReal playerForce = 200.f;
+		//move the players as kinematic bodies instead of dynamic ones held by D6 joints (set before Init)
+		bool kinematicPlayers = false;
+
+		//force pushing the obstacle between its triggers
+		PxReal obstacleForce = 20.f;
+
+		//contact force of the ball reported as a hard hit
+		PxReal hardHitForce = 2000.f;
+		//hard hits of the ball since the start of the game
+		int hardHits = 0;
+		//time left of the flash of the ball after a hard hit
+		PxReal hitFlash = 0.f;
+		bool hitFlashShown = false;
 
 		Player* player1, *player2;
 		Sphere* sphere;
 		int scorePlayer1, scorePlayer2; 
 		bool gameOver, direction;
 
+		//what to show in the debug render mode (generated only while Visualisation is on)
 		void SetVisualisation()
 		{
-			px_scene->setVisualizationParameter(PxVisualizationParameter::eSCALE, 1.0f);
 			px_scene->setVisualizationParameter(PxVisualizationParameter::eCOLLISION_SHAPES, 1.0f);
 			px_scene->setVisualizationParameter(PxVisualizationParameter::eBODY_AXES, 1.0f);
 			px_scene->setVisualizationParameter(PxVisualizationParameter::eJOINT_LOCAL_FRAMES, 1.0f);
@@ -227,8 +479,13 @@ namespace PhysicsEngine
 		{
 			SetVisualisation();
 			///Initialise and set the customised event callback
-			my_callback = new MySimulationEventCallback();
+			delete my_callback;
+			my_callback = new MySimulationEventCallback(this);
 			px_scene->setSimulationEventCallback(my_callback);
+			//flash the ball on hard hits (a new ball starts with its own colour)
+			hitFlash = 0.f;
+			hitFlashShown = false;
+			my_callback->OnHardHit([this](PxRigidActor*, PxRigidActor*) { hardHits++; hitFlash = .2f; });
 			
 
 			//Initialise scores when the scene is created
@@ -250,11 +507,16 @@ namespace PhysicsEngine
 			-------------------Set filtergroup of shape so it can be trigger contact with both goals----------------------
 			----------------------------------------------Add shape to scene---------------------------------------------*/
 			sphere = new Sphere(PxTransform(PxVec3(-20.f, 1.f, 0.f)));
-			PxMaterial* ballMaterial = CreateMaterial(0.f, 0.f, 1.f);
+			PxMaterial* ballMaterial = SharedMaterial(0.f, 0.f, 1.f);
 			sphere->Material(ballMaterial);
 			sphere->Name("Ball");
 			sphere->Color(PxVec3(0 / 255, 255 / 255, 255 / 255));
 			sphere->SetupFiltering(FilterGroup::Sphere, FilterGroup::GoalPlayer1 | FilterGroup::GoalPlayer2);
+			//the ball is fast enough after hitting the flipper or the motor arms to pass through the boundaries,
+			//CCD sweeps it, so it doesn't need substeps as well
+			sphere->SetCCD(true);
+			sphere->ContactReportThreshold(hardHitForce);
+			sphere->Solver(solver_light);
 			//sphere->SetKinematic(true);
 			Add(sphere);
 
@@ -263,10 +525,12 @@ namespace PhysicsEngine
 			-----------Dynamic flipper object which will cause the ball to rebound when it collides with this-------------
 			-------------Slightly increase the speed of any actor that comes into contact with the boundaries-------------
 			----------------------------------------------Add shape to scene---------------------------------------------*/
-			PxMaterial* flipperMaterial = CreateMaterial(0.2f, 0.f, 1.45f);
+			PxMaterial* flipperMaterial = SharedMaterial(0.2f, 0.f, 1.45f);
 			flipper = new Flipper(PxTransform(PxVec3(0.f, 0.f, 0.5f), PxQuat(PxPi / 2, PxVec3(1.f, 0.f, 0.f))));
 			flipper->Material(flipperMaterial);
 			flipper->Name("Flipper");
+			flipper->Solver(solver_jointed);
+			flipper->SetupFiltering(FilterGroup::Mover, 0);
 			Add(flipper);
 
 
@@ -283,9 +547,11 @@ namespace PhysicsEngine
 			------------------------------Shape has a unique and distinguishable colour (green)---------------------------
 			----------------------------------------------Add shape to scene---------------------------------------------*/
 			outskirts = new OutSkirtsSides();
-			PxMaterial* boundariesMaterial = CreateMaterial(0.0f, 0.f, 1.f);
+			PxMaterial* boundariesMaterial = SharedMaterial(0.0f, 0.f, 1.f);
 			outskirts->Material(boundariesMaterial);
 			outskirts->Color(PxVec3(0 / 255, 255 / 255, 0 / 255));
+			outskirts->SetupFiltering(FilterGroup::Boundary, 0);
+			//not aggregated: the bounds of the four sides cover the whole arena, so every actor would overlap the group
 			Add(outskirts);
 			
 
@@ -296,11 +562,13 @@ namespace PhysicsEngine
 			-------Sets the name of shape which can be used to check trigger events and movement in Visual Debugger-------
 			----------------------------------------------Add shape to scene---------------------------------------------*/
 			player1 = new Player(PxTransform(PxVec3(30.f, 0.f, 0.15f)));
-			playerMaterial = CreateMaterial(0.f, 0.f, 0.f);
+			playerMaterial = SharedMaterial(0.f, 0.f, 0.f);
 			player1->Material(playerMaterial);
 			player1->Name("Player 1");
 			player1->GetShape()->getActor()->setName("Player 1");
 			player1->Color(PxVec3(0 / 255.f, 0 / 255.f, 255 / 255.f));
+			player1->Solver(solver_light);
+			player1->SetupFiltering(FilterGroup::Player, 0);
 			Add(player1);
 
 
@@ -314,9 +582,27 @@ namespace PhysicsEngine
 			player2->Material(playerMaterial);
 			player2->Color(PxVec3(255 / 255.f, 0 / 255.f, 0 / 255.f));
 			player2->Name("Player 2");
+			player2->Solver(solver_light);
+			player2->SetupFiltering(FilterGroup::Player, 0);
 			player2->GetShape()->getActor()->setName("Player 2");
 			Add(player2);
 
+			//controllers keep the player bodies at hand for the input
+			delete controllers[0];
+			delete controllers[1];
+			controllers[0] = new PlayerController(player1, playerForce);
+			controllers[1] = new PlayerController(player2, playerForce);
+
+			//kinematic players stand on the ice and stay inside the boundaries by themselves
+			if (kinematicPlayers)
+			{
+				PxBounds3 area(PxVec3(-63.85f, 2.5f, -19.f), PxVec3(33.85f, 2.5f, 19.f));
+				((PxRigidDynamic*)player1->Get())->setGlobalPose(PxTransform(PxVec3(30.f, 2.5f, 0.15f)));
+				((PxRigidDynamic*)player2->Get())->setGlobalPose(PxTransform(PxVec3(-60.f, 2.5f, 0.15f)));
+				controllers[0]->Kinematic(area);
+				controllers[1]->Kinematic(area);
+			}
+
 
 			/*---------------------------------------------------Goal 1---------------------------------------------------
 			--------------------Creates new goal trigger, translates it to the right hand side of the screen--------------
@@ -358,17 +644,23 @@ namespace PhysicsEngine
 			motorArms = new MotorArms();
 			motorArms->Color(color_palette[3]);
 			motorArms->GetShape()->getActor()->setActorFlag(PxActorFlag::eDISABLE_GRAVITY, true);
-			motorArms->Material(CreateMaterial(0.f, 0.f, 1.75f));
+			motorArms->Material(SharedMaterial(0.f, 0.f, 1.75f));
 			motorArms->Name("Motor");
-			Add(motorArms);
+			motorArms->Solver(solver_jointed);
+			motorArms->SetupFiltering(FilterGroup::Mover, 0);
+			//the four arms enter the broadphase as one object
+			Aggregate* motorArmsGroup = new Aggregate(1);
+			motorArmsGroup->Add(motorArms);
+			Add(motorArmsGroup);
+			aggregates.push_back(motorArmsGroup);
 
 			
 			/*------------------------Added instance of springs using the trampoline class provided-----------------------
 			----------------------All translations and rotations are handled within the class itself----------------------
 			----------------A D6 joint was added to the bottom box to secure it to an anchor and lock axes----------------
 			------------------------Used custom method to add to scene rather than standard Add()-------------------------*/
-			Trampoline* tramp = new Trampoline();
-			tramp->AddToScene(this);
+			trampoline = new Trampoline();
+			trampoline->AddToScene(this);
 			
 
 			/*------------------------------------------Obstacle Trigger 1 and 2------------------------------------------
@@ -380,6 +672,7 @@ namespace PhysicsEngine
 			----------------------------------------------Add trigger to scene--------------------------------------------*/
 			obstacleTrigger1 = new Box(PxTransform(PxVec3(-15.f, 4.f, 23.65f)), PxVec3(3.f, 8.f, .25f));
 			obstacleTrigger1->SetTrigger(true);
+			obstacleTrigger1->SetupFiltering(FilterGroup::ObstacleTrigger, 0);
 			obstacleTrigger1->Color(PxVec3(0 / 255, 255 / 255, 0 / 255));
 			obstacleTrigger1->Material(boundariesMaterial);
 			obstacleTrigger1->Name("Obstacle Trigger Bottom");
@@ -388,6 +681,7 @@ namespace PhysicsEngine
 
 			obstacleTrigger2 = new Box(PxTransform(PxVec3(-15.f, 4.f, -23.65f)), PxVec3(3.f, 8.f, .25f));
 			obstacleTrigger2->SetTrigger(true);
+			obstacleTrigger2->SetupFiltering(FilterGroup::ObstacleTrigger, 0);
 			obstacleTrigger2->Color(PxVec3(0 / 255, 255 / 255, 0 / 255));
 			obstacleTrigger2->Material(boundariesMaterial);
 			obstacleTrigger2->Name("Obstacle Trigger Top");
@@ -396,6 +690,7 @@ namespace PhysicsEngine
 
 			obstacle = new Obstacle(PxTransform(PxVec3(-15.5f, 4.f, 3.5f)), PxVec3(0.5, 3.5, 7.5f), 1.f);
 			obstacle->Name("Obstacle");
+			obstacle->SetupFiltering(FilterGroup::Obstacle, 0);
 			obstacle->GetShape()->getActor()->setName("Obstacle");
 			Add(obstacle);
 
@@ -406,14 +701,26 @@ namespace PhysicsEngine
 			-D6 Joints are all constrained on the Y axis and allow for free movement on both X and Z, decided by booleans-
 			-------------------------------------------------------------------------------------------------------------*/
 			RevoluteJoint* joint = new RevoluteJoint(box, PxTransform(PxVec3(0.f, 0.f, 0.0f), PxQuat(PxPi / 2, PxVec3(0.f, 0.f, 1.f))), flipper, PxTransform(PxVec3(0.f, 0.0f, -10.0f), PxQuat(PxPi / 2, PxVec3(1.0f, 0.f, 0.f)))); //cant add drive velocity due to static actor
-			D6Joint* d6jointPlayer1 = new D6Joint(NULL, PxTransform(PxVec3(0.f, 3.f, 0.f)), player1, PxTransform(PxVec3(0.f, 0.5f, 0.f)), x = true, y = false, z = true);
-			D6Joint* d6jointPlayer2 = new D6Joint(NULL, PxTransform(PxVec3(0.f, 3.f, 0.f)), player2, PxTransform(PxVec3(0.f, 0.5f, 0.f)), x = true, y = false, z = true);
+			if (!kinematicPlayers)
+			{
+				D6Joint* d6jointPlayer1 = new D6Joint(NULL, PxTransform(PxVec3(0.f, 3.f, 0.f)), player1, PxTransform(PxVec3(0.f, 0.5f, 0.f)), x = true, y = false, z = true);
+				D6Joint* d6jointPlayer2 = new D6Joint(NULL, PxTransform(PxVec3(0.f, 3.f, 0.f)), player2, PxTransform(PxVec3(0.f, 0.5f, 0.f)), x = true, y = false, z = true);
+				joints.push_back(d6jointPlayer1);
+				joints.push_back(d6jointPlayer2);
+			}
 			D6Joint* d6jointBall = new D6Joint(NULL, PxTransform(PxVec3(-30.f, .75f, 0.f)), sphere, PxTransform(PxVec3(0.f, 0.5f, 0.f)), x = true, y = false, z = true);
 			D6Joint* d6jointObstacle = new D6Joint(NULL, PxTransform(PxVec3(-15.5f, 4.f, 3.5f)), obstacle, PxTransform(PxVec3(0.f, 0.f, 0.f)), x = false, y = false, z = true);
 			
 			//Motor joint with drive velocity applied to make a spiral of arms spin slightly offset from the centre to take up a larger area
 			RevoluteJoint* motorJoint = new RevoluteJoint(NULL, PxTransform(PxVec3(-40.f, 0.55f, 12.0f), PxQuat(PxPi / 2, PxVec3(0.f, 0.f, 1.f))), motorArms, PxTransform(PxVec3(4.75f, 0.f, -0.0f), PxQuat(PxPi / 2, PxVec3(0.0f, 0.f, 1.f))));
 			motorJoint->DriveVelocity(PxReal(-1));
+
+			joints.push_back(joint);
+			joints.push_back(d6jointBall);
+			joints.push_back(d6jointObstacle);
+			joints.push_back(motorJoint);
+			actors.insert(actors.end(), { plane, sphere, flipper, box, outskirts, player1, player2, goalTrigger1, goalTrigger2,
+				motorArms, obstacleTrigger1, obstacleTrigger2, obstacle });
 		}
 
 		//Add all players (interactable actors) to a vector - for use with movement in VisualDebugger
@@ -428,6 +735,25 @@ namespace PhysicsEngine
 
 			direction = my_callback->direction;
 
+			//the colour only changes when the flash starts and ends (the render table locks on every change)
+			if (hitFlash > 0.f)
+			{
+				if (!hitFlashShown)
+					sphere->Color(PxVec3(1.f, 1.f, 1.f));
+				hitFlashShown = true;
+
+				hitFlash -= TimeStep();
+				if (hitFlash <= 0.f)
+				{
+					sphere->Color(PxVec3(0 / 255, 255 / 255, 255 / 255));
+					hitFlashShown = false;
+				}
+			}
+
+			//one push per player for this step
+			controllers[0]->BeginStep();
+			controllers[1]->BeginStep();
+
 			//Frequently update score by checking the values in simulation callback
 			scorePlayer1 = my_callback->scorePlayer1;
 			scorePlayer2 = my_callback->scorePlayer2;
@@ -440,6 +766,20 @@ namespace PhysicsEngine
 				my_callback->isOver = false;
 			}
 		}
+
+		//Custom substep function (forces only last for a single simulate, so they are added before every one)
+		virtual void CustomSubstep()
+		{
+			controllers[0]->Apply(TimeStep());
+			controllers[1]->Apply(TimeStep());
+			PlayerController::Separate(*controllers[0], *controllers[1]);
+
+			//set forces to obstacle dependant on what direction the object should be heading
+			if (direction == true)
+				((PxRigidDynamic*)obstacle->Get())->addForce(PxVec3(0.f, 0.f, 1.f)*obstacleForce);
+			else
+				((PxRigidDynamic*)obstacle->Get())->addForce(PxVec3(0.f, 0.f, -1.f)*obstacleForce);
+		}
 		
 		//reset actor; disable simulation, set location relative to world and re-enabling - removing all forces and acceleration
 		void resetScene()
@@ -460,6 +800,9 @@ namespace PhysicsEngine
 			player2->Get()->setActorFlag(PxActorFlag::eDISABLE_SIMULATION, true);
 			player2->GetShape()->getActor()->setGlobalPose(PxTransform(PxVec3(-60.5f, 2.5f, .0f)));
 			player2->Get()->setActorFlag(PxActorFlag::eDISABLE_SIMULATION, false);
+
+			controllers[0]->Stop();
+			controllers[1]->Stop();
 		}
 
 		//set score to 0 for a new game and change bool which changes game state
@@ -468,6 +811,7 @@ namespace PhysicsEngine
 			my_callback->scorePlayer1 = 0;
 			my_callback->scorePlayer2 = 0;
 			my_callback->gameOver = false;
+			hardHits = 0;
 			resetScene();
 		}
 	};
@@ -1,5 +1,9 @@
 #include "PhysicsEngine.h"
 #include <iostream>
+#include <cstdio>
+#include <direct.h>
+#include <algorithm>
+#include <mutex>
 
 namespace PhysicsEngine
 {
@@ -15,6 +19,14 @@ namespace PhysicsEngine
 	debugger::comm::PvdConnection* vd_connection = 0;
 	PxPhysics* physics = 0;
 	PxCooking* cooking = 0;
+	//visual debugger settings
+	PvdConfig pvd_config;
+	//folder with the cooked meshes
+	std::string cooking_cache = "CookedMeshes";
+
+	//materials handed out by SharedMaterial, released with the physics
+	std::vector<PxMaterial*> shared_materials;
+	std::mutex shared_materials_mutex;
 
 	///PhysX functions
 	void PxInit()
@@ -33,27 +45,33 @@ namespace PhysicsEngine
 		if(!physics)
 			throw new Exception("PhysicsEngine::PxInit, Could not initialise the PhysX SDK.");
 
-		if (!cooking)
-			cooking = PxCreateCooking(PX_PHYSICS_VERSION, *foundation, PxCookingParams(PxTolerancesScale()));
-
-		if(!cooking)
-			throw new Exception("PhysicsEngine::PxInit, Could not initialise the cooking component.");
-
-		//visual debugger
+		//visual debugger, only when asked for
 		if (!vd_connection)
-			vd_connection = PxVisualDebuggerExt::createConnection(physics->getPvdConnectionManager(), 
-			"localhost", 5425, 100, PxVisualDebuggerExt::getAllConnectionFlags());
+		{
+			if (pvd_config.mode == PvdConfig::eSOCKET)
+				vd_connection = PxVisualDebuggerExt::createConnection(physics->getPvdConnectionManager(), 
+				pvd_config.host.c_str(), pvd_config.port, pvd_config.timeout, pvd_config.flags);
+			else if (pvd_config.mode == PvdConfig::eFILE)
+				vd_connection = PxVisualDebuggerExt::createConnection(physics->getPvdConnectionManager(), 
+				pvd_config.file.c_str(), pvd_config.flags);
+		}
 
 		//create a deafult material
 		CreateMaterial();
 	}
 
+	void PvdSettings(const PvdConfig& config)
+	{
+		pvd_config = config;
+	}
+
 	void PxRelease()
 	{
 		if (vd_connection)
 			vd_connection->release();
 		if (cooking)
 			cooking->release();
+		shared_materials.clear();
 		if (physics)
 			physics->release();
 		if (foundation)
@@ -65,11 +83,165 @@ namespace PhysicsEngine
 		return physics; 
 	}
 
+	///Parameters of the cooking library, or the ones it will be created with
+	static PxCookingParams CookingParams()
+	{
+		return cooking ? cooking->getParams() : PxCookingParams(physics->getTolerancesScale());
+	}
+
 	PxCooking* GetCooking()
 	{
+		//most scenes don't cook anything, or find all their meshes in the cache
+		if (!cooking)
+			cooking = PxCreateCooking(PX_PHYSICS_VERSION, *foundation, CookingParams());
+
+		if (!cooking)
+			throw new Exception("PhysicsEngine::GetCooking, Could not initialise the cooking component.");
+
 		return cooking;
 	}
 
+	void CookingCache(const std::string& folder)
+	{
+		cooking_cache = folder;
+	}
+
+	///FNV-1a hash of a block of memory
+	static PxU64 Hash(PxU64 hash, const void* data, PxU32 size)
+	{
+		const PxU8* bytes = (const PxU8*)data;
+		for (PxU32 i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	static PxU64 Hash(PxU64 hash, const T& value)
+	{
+		return Hash(hash, &value, sizeof(T));
+	}
+
+	///Hash strided mesh data, element by element
+	static PxU64 Hash(PxU64 hash, const PxBoundedData& data, PxU32 element_size)
+	{
+		hash = Hash(hash, data.count);
+		for (PxU32 i = 0; i < data.count; i++)
+			hash = Hash(hash, (const PxU8*)data.data + i*data.stride, element_size);
+		return hash;
+	}
+
+	///Hash the cooking parameters that change the cooked stream
+	static PxU64 Hash(PxU64 hash, const PxCookingParams& params)
+	{
+		hash = Hash(hash, (PxU32)PX_PHYSICS_VERSION);
+		hash = Hash(hash, params.scale.length);
+		hash = Hash(hash, params.scale.mass);
+		hash = Hash(hash, params.scale.speed);
+		hash = Hash(hash, params.areaTestEpsilon);
+		hash = Hash(hash, (PxU32)params.meshPreprocessParams);
+		hash = Hash(hash, params.meshWeldTolerance);
+		hash = Hash(hash, (PxU32)params.targetPlatform);
+		hash = Hash(hash, params.suppressTriangleMeshRemapTable);
+		hash = Hash(hash, params.buildTriangleAdjacencies);
+		return hash;
+	}
+
+	///Cache file for a hash, empty if the cache is disabled
+	static std::string CacheFile(PxU64 hash, const char* extension)
+	{
+		if (cooking_cache.empty())
+			return "";
+
+		char name[17];
+		sprintf_s(name, "%016llx", hash);
+		return cooking_cache + "/" + name + extension;
+	}
+
+	///Store a cooked stream in the cache, failures only mean the mesh will be cooked again next time
+	static void CacheStore(const std::string& file, const PxDefaultMemoryOutputStream& stream)
+	{
+		if (file.empty())
+			return;
+
+		_mkdir(cooking_cache.c_str());
+		PxDefaultFileOutputStream output(file.c_str());
+		if (output.isValid())
+			output.write(stream.getData(), stream.getSize());
+	}
+
+	PxConvexMesh* CookConvexMesh(const PxConvexMeshDesc& mesh_desc)
+	{
+		static const PxU64 fnv_offset = 14695981039346656037ULL;
+
+		PxU64 hash = Hash(fnv_offset, PxU32(0));
+		hash = Hash(hash, mesh_desc.points, sizeof(PxVec3));
+		hash = Hash(hash, mesh_desc.polygons, sizeof(PxHullPolygon));
+		hash = Hash(hash, mesh_desc.indices, (mesh_desc.flags & PxConvexFlag::e16_BIT_INDICES) ? sizeof(PxU16) : sizeof(PxU32));
+		hash = Hash(hash, (PxU16)mesh_desc.flags);
+		hash = Hash(hash, mesh_desc.vertexLimit);
+		//the cooking library is only created when the cache misses
+		hash = Hash(hash, CookingParams());
+
+		//try the cache first
+		std::string file = CacheFile(hash, ".convex");
+		if (!file.empty())
+		{
+			PxDefaultFileInputData input(file.c_str());
+			if (input.isValid())
+			{
+				PxConvexMesh* mesh = GetPhysics()->createConvexMesh(input);
+				if (mesh)
+					return mesh;
+			}
+		}
+
+		PxDefaultMemoryOutputStream stream;
+		if (!GetCooking()->cookConvexMesh(mesh_desc, stream))
+			throw new Exception("PhysicsEngine::CookConvexMesh, cooking failed.");
+
+		CacheStore(file, stream);
+
+		PxDefaultMemoryInputData input(stream.getData(), stream.getSize());
+		return GetPhysics()->createConvexMesh(input);
+	}
+
+	PxTriangleMesh* CookTriangleMesh(const PxTriangleMeshDesc& mesh_desc)
+	{
+		static const PxU64 fnv_offset = 14695981039346656037ULL;
+
+		PxU64 hash = Hash(fnv_offset, PxU32(1));
+		hash = Hash(hash, mesh_desc.points, sizeof(PxVec3));
+		hash = Hash(hash, mesh_desc.triangles, (mesh_desc.flags & PxMeshFlag::e16_BIT_INDICES) ? 3*sizeof(PxU16) : 3*sizeof(PxU32));
+		hash = Hash(hash, (PxU16)mesh_desc.flags);
+		//the cooking library is only created when the cache misses
+		hash = Hash(hash, CookingParams());
+
+		//try the cache first
+		std::string file = CacheFile(hash, ".mesh");
+		if (!file.empty())
+		{
+			PxDefaultFileInputData input(file.c_str());
+			if (input.isValid())
+			{
+				PxTriangleMesh* mesh = GetPhysics()->createTriangleMesh(input);
+				if (mesh)
+					return mesh;
+			}
+		}
+
+		PxDefaultMemoryOutputStream stream;
+		if (!GetCooking()->cookTriangleMesh(mesh_desc, stream))
+			throw new Exception("PhysicsEngine::CookTriangleMesh, cooking failed.");
+
+		CacheStore(file, stream);
+
+		PxDefaultMemoryInputData input(stream.getData(), stream.getSize());
+		return GetPhysics()->createTriangleMesh(input);
+	}
+
 	PxMaterial* GetMaterial(PxU32 index)
 	{
 		std::vector<PxMaterial*> materials(physics->getNbMaterials());
@@ -84,6 +256,22 @@ namespace PhysicsEngine
 		return physics->createMaterial(sf, df, cr);
 	}
 
+	PxMaterial* SharedMaterial(PxReal sf, PxReal df, PxReal cr)
+	{
+		//scenes can be created on several threads
+		std::lock_guard<std::mutex> lock(shared_materials_mutex);
+
+		for (unsigned int i = 0; i < shared_materials.size(); i++)
+		{
+			PxMaterial* material = shared_materials[i];
+			if ((material->getStaticFriction() == sf) && (material->getDynamicFriction() == df) && (material->getRestitution() == cr))
+				return material;
+		}
+
+		shared_materials.push_back(CreateMaterial(sf, df, cr));
+		return shared_materials.back();
+	}
+
 	///Actor methods
 
 	///Constructor
@@ -94,25 +282,27 @@ namespace PhysicsEngine
 
 	void Actor::Color(PxVec3 new_color, PxU32 shape_index)
 	{
-		//change color of all shapes
-		if (shape_index == -1)
-		{
-			for (unsigned int i = 0; i < colors.size(); i++)
-				colors[i] = new_color;
-		}
-		//or only the selected one
-		else if (shape_index < colors.size())
+		//a cloth has a single row in the render table
+		if (actor->isCloth())
 		{
-			colors[shape_index] = new_color;
+			RenderTable::Get().Color(RenderTable::Row(actor->userData), new_color);
+			return;
 		}
+
+		//change color of all shapes or only the selected one
+		std::vector<PxShape*> shape_list = GetShapes(shape_index);
+		for (PxU32 i = 0; i < shape_list.size(); i++)
+			RenderTable::Get().Color(RenderTable::Row(shape_list[i]->userData), new_color);
 	}
 
-	const PxVec3* Actor::Color(PxU32 shape_indx)
+	PxVec3 Actor::Color(PxU32 shape_indx)
 	{
-		if (shape_indx < colors.size())
-			return &colors[shape_indx];
+		PxShape* shape = actor->isCloth() ? 0 : GetShape(shape_indx);
+		PxU32 row = RenderTable::Row(actor->isCloth() ? actor->userData : (shape ? shape->userData : 0));
+		if (row < RenderTable::Get().Size())
+			return RenderTable::Get().color[row];
 		else 
-			return 0;			
+			return default_color;
 	}
 
 	void Actor::Material(PxMaterial* new_material, PxU32 shape_index)
@@ -164,11 +354,18 @@ namespace PhysicsEngine
 	{
 		std::vector<PxShape*> shape_list = GetShapes(shape_index);
 		for (PxU32 i = 0; i < shape_list.size(); i++)
-			shape_list[i]->setSimulationFilterData(PxFilterData(filterGroup, filterMask,0,0));
+		{
+			//keep the per-actor options in the remaining words
+			PxFilterData data = shape_list[i]->getSimulationFilterData();
+			data.word0 = filterGroup;
+			data.word1 = filterMask;
+			shape_list[i]->setSimulationFilterData(data);
+		}
 
-		// PxFilterData(word0, word1, 0, 0)
+		// PxFilterData(word0, word1, word2, word3)
 		// word0 = own ID
 		// word1 = ID mask to filter pairs that trigger a contact callback
+		// word3 = FilterFlag options
 	}
 
 	void Actor::Name(const string& new_name)
@@ -185,24 +382,30 @@ namespace PhysicsEngine
 	DynamicActor::DynamicActor(const PxTransform& pose) : Actor()
 	{
 		actor = (PxActor*)GetPhysics()->createRigidDynamic(pose);
+		//let the scene know when the actor goes to sleep or wakes up
+		actor->setActorFlag(PxActorFlag::eSEND_SLEEP_NOTIFIES, true);
 		Name("");
 	}
 
 	DynamicActor::~DynamicActor()
 	{
-		for (unsigned int i = 0; i < colors.size(); i++)
-			delete (UserData*)GetShape(i)->userData;
+		PxScene* px_scene = actor->getScene();
+		if (px_scene && px_scene->userData)
+			((Scene*)px_scene->userData)->Forget(this);
+
+		std::vector<PxShape*> shapes = GetShapes();
+		for (unsigned int i = 0; i < shapes.size(); i++)
+			RenderTable::Get().Release(RenderTable::Row(shapes[i]->userData));
+		//also removes the actor from its scene
+		actor->release();
 	}
 
 	void DynamicActor::CreateShape(const PxGeometry& geometry, PxReal density)
 	{
 		PxShape* shape = ((PxRigidDynamic*)actor)->createShape(geometry,*GetMaterial());
 		PxRigidBodyExt::updateMassAndInertia(*(PxRigidDynamic*)actor, density);
-		colors.push_back(default_color);
-		//pass the color pointers to the renderer
-		shape->userData = new UserData();
-		for (unsigned int i = 0; i < colors.size(); i++)
-			((UserData*)GetShape(i)->userData)->color = &colors[i];
+		//the renderer finds the color of the shape in its row of the render table
+		shape->userData = RenderTable::Attach(RenderTable::Get().Create(default_color));
 	}
 
 	void DynamicActor::SetKinematic(bool value, PxU32 index)
@@ -210,6 +413,67 @@ namespace PhysicsEngine
 		((PxRigidDynamic*)actor)->setRigidDynamicFlag(PxRigidDynamicFlag::eKINEMATIC, value);
 	}
 
+	void DynamicActor::SleepThreshold(PxReal value)
+	{
+		((PxRigidDynamic*)actor)->setSleepThreshold(value);
+	}
+
+	PxReal DynamicActor::SleepThreshold()
+	{
+		return ((PxRigidDynamic*)actor)->getSleepThreshold();
+	}
+
+	void DynamicActor::WakeCounter(PxReal value)
+	{
+		((PxRigidDynamic*)actor)->setWakeCounter(value);
+	}
+
+	PxReal DynamicActor::WakeCounter()
+	{
+		return ((PxRigidDynamic*)actor)->getWakeCounter();
+	}
+
+	void DynamicActor::Solver(const SolverProfile& profile)
+	{
+		PxRigidDynamic* body = (PxRigidDynamic*)actor;
+		body->setSolverIterationCounts(profile.position_iterations, profile.velocity_iterations);
+		body->setMaxDepenetrationVelocity(profile.max_depenetration_velocity);
+		body->setSleepThreshold(profile.sleep_threshold);
+		body->setStabilizationThreshold(profile.stabilization_threshold);
+	}
+
+	void DynamicActor::SetCCD(bool value)
+	{
+		((PxRigidDynamic*)actor)->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD, value);
+
+		//mark the shapes for the filter shader
+		std::vector<PxShape*> shape_list = GetShapes();
+		for (PxU32 i = 0; i < shape_list.size(); i++)
+		{
+			PxFilterData data = shape_list[i]->getSimulationFilterData();
+			if (value)
+				data.word3 |= FilterFlag::CCD;
+			else
+				data.word3 &= ~FilterFlag::CCD;
+			shape_list[i]->setSimulationFilterData(data);
+		}
+	}
+
+	bool DynamicActor::CCD()
+	{
+		return ((PxRigidDynamic*)actor)->getRigidBodyFlags() & PxRigidBodyFlag::eENABLE_CCD;
+	}
+
+	void DynamicActor::ContactReportThreshold(PxReal value)
+	{
+		((PxRigidDynamic*)actor)->setContactReportThreshold(value);
+	}
+
+	PxReal DynamicActor::ContactReportThreshold()
+	{
+		return ((PxRigidDynamic*)actor)->getContactReportThreshold();
+	}
+
 	StaticActor::StaticActor(const PxTransform& pose)
 	{
 		actor = (PxActor*)GetPhysics()->createRigidStatic(pose);
@@ -218,18 +482,59 @@ namespace PhysicsEngine
 
 	StaticActor::~StaticActor()
 	{
-		for (unsigned int i = 0; i < colors.size(); i++)
-			delete (UserData*)GetShape(i)->userData;
+		PxScene* px_scene = actor->getScene();
+		if (px_scene && px_scene->userData)
+			((Scene*)px_scene->userData)->Forget(this);
+
+		std::vector<PxShape*> shapes = GetShapes();
+		for (unsigned int i = 0; i < shapes.size(); i++)
+			RenderTable::Get().Release(RenderTable::Row(shapes[i]->userData));
+		//also removes the actor from its scene
+		actor->release();
 	}
 
 	void StaticActor::CreateShape(const PxGeometry& geometry, PxReal density)
 	{
 		PxShape* shape = ((PxRigidStatic*)actor)->createShape(geometry,*GetMaterial());
-		colors.push_back(default_color);
-		//pass the color pointers to the renderer
-		shape->userData = new UserData();
-		for (unsigned int i = 0; i < colors.size(); i++)
-			((UserData*)GetShape(i)->userData)->color = &colors[i];
+		//the renderer finds the color of the shape in its row of the render table
+		shape->userData = RenderTable::Attach(RenderTable::Get().Create(default_color, 0, RenderTable::STATIC));
+	}
+
+	void StaticActor::Pose(const PxTransform& pose)
+	{
+		((PxRigidStatic*)actor)->setGlobalPose(pose);
+		RenderTable::Get().StaticChanged();
+	}
+
+	///Aggregate methods
+
+	Aggregate::Aggregate(PxU32 max_actors, bool self_collision)
+	{
+		aggregate = GetPhysics()->createAggregate(max_actors, self_collision);
+		if (!aggregate)
+			throw new Exception("Aggregate::Aggregate, could not create the aggregate.");
+	}
+
+	void Aggregate::Add(Actor* actor)
+	{
+		if (!aggregate->addActor(*actor->Get()))
+			throw new Exception("Aggregate::Add, could not add the actor (too many actors?).");
+		actors.push_back(actor);
+	}
+
+	PxAggregate* Aggregate::Get()
+	{
+		return aggregate;
+	}
+
+	Aggregate::~Aggregate()
+	{
+		aggregate->release();
+	}
+
+	const std::vector<Actor*>& Aggregate::Actors()
+	{
+		return actors;
 	}
 
 	///Scene methods
@@ -238,24 +543,31 @@ namespace PhysicsEngine
 		//scene
 		PxSceneDesc sceneDesc(GetPhysics()->getTolerancesScale());
 
-		if(!sceneDesc.cpuDispatcher)
-		{
-			PxDefaultCpuDispatcher* mCpuDispatcher = PxDefaultCpuDispatcherCreate(1);
-			sceneDesc.cpuDispatcher = mCpuDispatcher;
-		}
+		//the dispatcher is kept when the scene is reset
+		if (!cpu_dispatcher)
+			cpu_dispatcher = PxDefaultCpuDispatcherCreate(worker_threads);
+
+		sceneDesc.cpuDispatcher = cpu_dispatcher;
 
 		sceneDesc.filterShader = filter_shader;
 		
-		//sceneDesc.flags |= PxSceneFlag::eENABLE_CCD;
+		//CCD is switched on per actor (DynamicActor::SetCCD)
+		sceneDesc.flags |= PxSceneFlag::eENABLE_CCD;
 
 		px_scene = GetPhysics()->createScene(sceneDesc);
 
 		if (!px_scene)
 			throw new Exception("PhysicsEngine::Scene::Init, Could not initialise the scene.");
 
+		//actors find the scene they are in when they are released
+		px_scene->userData = this;
+
 		//default gravity
 		px_scene->setGravity(PxVec3(0.0f, -9.81f, 0.0f));
 
+		//the overall scale switches all debug visualisation on or off
+		px_scene->setVisualizationParameter(PxVisualizationParameter::eSCALE, visualisation ? 1.f : 0.f);
+
 		CustomInit();
 
 		pause = false;
@@ -268,20 +580,157 @@ namespace PhysicsEngine
 		//GetSelectedActor()->setActorFlag(PxActorFlag::eDISABLE_SIMULATION, false);
 	}
 
+	void Scene::Release()
+	{
+		sleeping_actors.clear();
+		fast_actors.clear();
+
+		if (px_scene)
+		{
+			CustomRelease();
+			px_scene->release();
+		}
+		px_scene = 0;
+
+		if (cpu_dispatcher)
+			cpu_dispatcher->release();
+		cpu_dispatcher = 0;
+	}
+
+	void Scene::WorkerThreads(PxU32 value)
+	{
+		worker_threads = value;
+	}
+
 	void Scene::Update(PxReal dt)
 	{
 		if (pause)
 			return;
 
+		time_step = dt;
 		CustomUpdate();
 
-		px_scene->simulate(dt);
-		px_scene->fetchResults(true);
+		//split the step only when the fastest actor would move too far relative to the thinnest collider
+		PxU32 substeps = 1;
+		if ((fast_speed > 0.f) && (thinnest_collider < PX_MAX_F32))
+		{
+			PxReal max_distance = thinnest_collider*substep_fraction;
+			substeps = PxClamp((PxU32)PxCeil(fast_speed*dt / max_distance), (PxU32)1, max_substeps);
+		}
+
+		time_step = dt / substeps;
+		for (PxU32 i = 0; i < substeps; i++)
+		{
+			CustomSubstep();
+			px_scene->simulate(time_step);
+			px_scene->fetchResults(true);
+		}
+		time_step = dt;
+
+		//the velocities after this step decide the next one (sleeping actors don't move)
+		PxReal max_speed_squared = 0.f;
+		for (unsigned int i = 0; i < fast_actors.size(); i++)
+			if (!IsSleeping(fast_actors[i]))
+				max_speed_squared = PxMax(max_speed_squared, fast_actors[i]->getLinearVelocity().magnitudeSquared());
+		fast_speed = PxSqrt(max_speed_squared);
+	}
+
+	PxReal Scene::TimeStep()
+	{
+		return time_step;
+	}
+
+	void Scene::AddFastActor(Actor* actor)
+	{
+		//CCD already stops these actors from tunnelling, substeps would only add to the cost
+		if (actor->Get()->isRigidDynamic() && !((DynamicActor*)actor)->CCD())
+			fast_actors.push_back((PxRigidDynamic*)actor->Get());
+	}
+
+	void Scene::SubstepPolicy(PxReal fraction, PxU32 max)
+	{
+		substep_fraction = fraction;
+		max_substeps = PxMax(max, (PxU32)1);
+	}
+
+	void Scene::UpdateThinnestCollider(Actor* actor)
+	{
+		//only static colliders are guarded against, dynamic bodies move out of the way
+		if (!actor->Get()->isRigidStatic())
+			return;
+
+		//only primitive shapes have a simple thickness, meshes and planes are skipped
+		std::vector<PxShape*> shapes = actor->GetShapes();
+		for (unsigned int i = 0; i < shapes.size(); i++)
+		{
+			//nothing can tunnel through a trigger
+			if (shapes[i]->getFlags() & PxShapeFlag::eTRIGGER_SHAPE)
+				continue;
+
+			PxGeometryHolder h = shapes[i]->getGeometry();
+			switch (h.getType())
+			{
+			case PxGeometryType::eBOX:
+				thinnest_collider = PxMin(thinnest_collider, 2.f*h.box().halfExtents.minElement());
+				break;
+			case PxGeometryType::eSPHERE:
+				thinnest_collider = PxMin(thinnest_collider, 2.f*h.sphere().radius);
+				break;
+			case PxGeometryType::eCAPSULE:
+				thinnest_collider = PxMin(thinnest_collider, 2.f*h.capsule().radius);
+				break;
+			default:
+				break;
+			}
+		}
 	}
 
 	void Scene::Add(Actor* actor)
 	{
 		px_scene->addActor(*actor->Get());
+		UpdateThinnestCollider(actor);
+		if (actor->Get()->isRigidStatic())
+			static_revision++;
+	}
+
+	void Scene::Add(Aggregate* aggregate)
+	{
+		px_scene->addAggregate(*aggregate->Get());
+
+		const std::vector<Actor*>& actors = aggregate->Actors();
+		for (unsigned int i = 0; i < actors.size(); i++)
+		{
+			UpdateThinnestCollider(actors[i]);
+			if (actors[i]->Get()->isRigidStatic())
+				static_revision++;
+		}
+	}
+
+	void Scene::Remove(Actor* actor)
+	{
+		Forget(actor);
+		px_scene->removeActor(*actor->Get());
+	}
+
+	void Scene::Forget(Actor* actor)
+	{
+		SetSleeping(actor->Get(), false);
+		for (unsigned int i = 0; i < fast_actors.size(); i++)
+		{
+			if (fast_actors[i] == actor->Get())
+			{
+				fast_actors.erase(fast_actors.begin() + i);
+				break;
+			}
+		}
+		if (actor->Get()->isRigidStatic())
+			static_revision++;
+	}
+
+	PxU32 Scene::StaticRevision()
+	{
+		//recolouring or moving a static is tracked by the render table
+		return static_revision + RenderTable::Get().StaticRevision();
 	}
 
 	PxScene* Scene::Get() 
@@ -289,9 +738,76 @@ namespace PhysicsEngine
 		return px_scene; 
 	}
 
+	void Scene::Visualisation(bool value)
+	{
+		visualisation = value;
+		px_scene->setVisualizationParameter(PxVisualizationParameter::eSCALE, visualisation ? 1.f : 0.f);
+	}
+
+	bool Scene::Visualisation()
+	{
+		return visualisation;
+	}
+
+	void Scene::VisualisationCullingBox(const PxBounds3& box)
+	{
+		px_scene->setVisualizationCullingBox(box);
+	}
+
+	void Scene::SetSleeping(PxActor* actor, bool value)
+	{
+		if (value)
+			sleeping_actors.insert(actor);
+		else
+			sleeping_actors.erase(actor);
+
+		if (!actor->isRigidDynamic())
+			return;
+
+		//flag the shapes so that the renderer can reuse their pose and bounds
+		PxRigidDynamic* rigid_actor = (PxRigidDynamic*)actor;
+		std::vector<PxShape*> shapes(rigid_actor->getNbShapes());
+		if (shapes.size())
+			rigid_actor->getShapes((PxShape**)&shapes.front(), (PxU32)shapes.size());
+
+		for (unsigned int i = 0; i < shapes.size(); i++)
+		{
+			PxU32 row = RenderTable::Row(shapes[i]->userData);
+			RenderTable::Get().Flags(row, RenderTable::SLEEPING, value);
+			RenderTable::Get().Flags(row, RenderTable::CACHED, false);
+		}
+	}
+
+	void Scene::OnSleep(PxActor** actors, PxU32 count)
+	{
+		for (PxU32 i = 0; i < count; i++)
+			SetSleeping(actors[i], true);
+	}
+
+	void Scene::OnWake(PxActor** actors, PxU32 count)
+	{
+		for (PxU32 i = 0; i < count; i++)
+			SetSleeping(actors[i], false);
+	}
+
+	bool Scene::IsSleeping(PxActor* actor)
+	{
+		return sleeping_actors.count(actor) != 0;
+	}
+
+	PxU32 Scene::SleepingCount()
+	{
+		return (PxU32)sleeping_actors.size();
+	}
+
 
 	void Scene::Reset()
 	{
+		sleeping_actors.clear();
+		fast_actors.clear();
+		thinnest_collider = PX_MAX_F32;
+		fast_speed = 0.f;
+		CustomRelease();
 		px_scene->release();
 		Init();
 	}
@@ -365,27 +881,102 @@ namespace PhysicsEngine
 
 	void Scene::HighlightOn(PxRigidDynamic* actor)
 	{
-		//store the original colour and adjust brightness of the selected actor
+		//the renderer adjusts brightness of the highlighted shapes
 		std::vector<PxShape*> shapes(actor->getNbShapes());
 		actor->getShapes((PxShape**)&shapes.front(), (PxU32)shapes.size());
 
-		sactor_color_orig.clear();
-
 		for (unsigned int i = 0; i < shapes.size(); i++)
-		{
-			PxVec3* color = ((UserData*)shapes[i]->userData)->color;
-			sactor_color_orig.push_back(*color);
-			*color += PxVec3(.2f,.2f,.2f);
-		}
+			RenderTable::Get().Flags(RenderTable::Row(shapes[i]->userData), RenderTable::HIGHLIGHT, true);
 	}
 
 	void Scene::HighlightOff(PxRigidDynamic* actor)
 	{
-		//restore the original color
 		std::vector<PxShape*> shapes(actor->getNbShapes());
 		actor->getShapes((PxShape**)&shapes.front(), (PxU32)shapes.size());
 
 		for (unsigned int i = 0; i < shapes.size(); i++)
-			*((UserData*)shapes[i]->userData)->color = sactor_color_orig[i];
+			RenderTable::Get().Flags(RenderTable::Row(shapes[i]->userData), RenderTable::HIGHLIGHT, false);
+	}
+
+	///ActorPool methods
+	ActorPool::ActorPool(Scene* _scene, PxU32 size, const std::function<DynamicActor*()>& prototype, bool _fast)
+		: scene(_scene), spawned(size, false), fast(_fast)
+	{
+		for (PxU32 i = 0; i < size; i++)
+		{
+			DynamicActor* actor = prototype();
+			if (!actor)
+				throw new Exception("ActorPool::ActorPool, the prototype did not create an actor.");
+			actors.push_back(actor);
+		}
+		//spawn from the front
+		free_actors.assign(actors.rbegin(), actors.rend());
+	}
+
+	ActorPool::~ActorPool()
+	{
+		DespawnAll();
+		for (unsigned int i = 0; i < actors.size(); i++)
+			delete actors[i];
+	}
+
+	DynamicActor* ActorPool::Spawn(const PxTransform& pose, const PxVec3& velocity)
+	{
+		if (free_actors.empty())
+			return 0;
+
+		DynamicActor* actor = free_actors.back();
+		free_actors.pop_back();
+		spawned[std::find(actors.begin(), actors.end(), actor) - actors.begin()] = true;
+
+		//reset the state left over from the last spawn
+		PxRigidDynamic* body = (PxRigidDynamic*)actor->Get();
+		body->setGlobalPose(pose);
+		if (!(body->getRigidDynamicFlags() & PxRigidDynamicFlag::eKINEMATIC))
+		{
+			body->setLinearVelocity(velocity);
+			body->setAngularVelocity(PxVec3(0.f));
+		}
+
+		scene->Add(actor);
+		if (fast)
+			scene->AddFastActor(actor);
+
+		//a despawned actor may have gone to sleep before it was removed
+		if (!(body->getRigidDynamicFlags() & PxRigidDynamicFlag::eKINEMATIC))
+			body->wakeUp();
+
+		return actor;
+	}
+
+	void ActorPool::Despawn(DynamicActor* actor)
+	{
+		unsigned int index = std::find(actors.begin(), actors.end(), actor) - actors.begin();
+		if (index == actors.size())
+			throw new Exception("ActorPool::Despawn, the actor is not from this pool.");
+		if (!spawned[index])
+			return;
+
+		//actors spawned before Scene::Reset were dropped with the old PhysX scene
+		if (actor->Get()->getScene() == scene->Get())
+			scene->Remove(actor);
+		spawned[index] = false;
+		free_actors.push_back(actor);
+	}
+
+	void ActorPool::DespawnAll()
+	{
+		for (unsigned int i = 0; i < actors.size(); i++)
+			Despawn(actors[i]);
+	}
+
+	PxU32 ActorPool::Free()
+	{
+		return (PxU32)free_actors.size();
+	}
+
+	PxU32 ActorPool::Size()
+	{
+		return (PxU32)actors.size();
 	}
 }
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <vector>
+#include <unordered_set>
+#include <functional>
 #include "PxPhysicsAPI.h"
 #include "Exception.h"
-#include "Extras\UserData.h"
+#include "Extras\RenderTable.h"
 #include <string>
 
 namespace PhysicsEngine
@@ -11,6 +13,35 @@ namespace PhysicsEngine
 	using namespace physx;
 	using namespace std;
 	
+	///Visual debugger connection settings
+	struct PvdConfig
+	{
+		enum Mode
+		{
+			//no connection (default)
+			eNONE,
+			//stream to a running visual debugger
+			eSOCKET,
+			//capture into a file for offline inspection
+			eFILE
+		};
+
+		Mode mode;
+		std::string host;
+		PxU32 port;
+		//connection timeout in ms
+		PxU32 timeout;
+		std::string file;
+		//what to send: eDEBUG, ePROFILE and/or eMEMORY
+		PxVisualDebuggerConnectionFlags flags;
+
+		PvdConfig() : mode(eNONE), host("localhost"), port(5425), timeout(100), file("capture.pxd2"),
+			flags(PxVisualDebuggerConnectionFlag::eDEBUG) {}
+	};
+
+	///Set up the visual debugger connection made by PxInit (none by default)
+	void PvdSettings(const PvdConfig& config);
+
 	///Initialise PhysX framework
 	void PxInit();
 
@@ -20,24 +51,119 @@ namespace PhysicsEngine
 	///Get the PxPhysics object
 	PxPhysics* GetPhysics();
 
-	///Get the cooking object
+	///Get the cooking object (created on first use)
 	PxCooking* GetCooking();
 
+	///Set the folder for cooked mesh streams (an empty string disables the cache)
+	void CookingCache(const std::string& folder);
+
+	///Cook a convex mesh, or load it from the cache if the same input was cooked before (the caller releases the mesh)
+	PxConvexMesh* CookConvexMesh(const PxConvexMeshDesc& mesh_desc);
+
+	///Cook a triangle mesh, or load it from the cache if the same input was cooked before (the caller releases the mesh)
+	PxTriangleMesh* CookTriangleMesh(const PxTriangleMeshDesc& mesh_desc);
+
 	///Get the specified material
 	PxMaterial* GetMaterial(PxU32 index=0);
 
 	///Create a new material
 	PxMaterial* CreateMaterial(PxReal sf=.0f, PxReal df=.0f, PxReal cr=.0f);
 
+	///Get a material with these coefficients, created on the first request and shared by all scenes afterwards
+	PxMaterial* SharedMaterial(PxReal sf=.0f, PxReal df=.0f, PxReal cr=.0f);
+
 	static const PxVec3 default_color(.8f,.8f,.8f);
 
+	///Per-actor options stored in word3 of the simulation filter data
+	struct FilterFlag
+	{
+		enum Enum
+		{
+			//the filter shader enables continuous collision detection for pairs with this actor
+			CCD = (1 << 0)
+		};
+	};
+
+	///What the filter shader does with a pair of filter groups (flags can be combined)
+	struct PairPolicy
+	{
+		enum Enum
+		{
+			//drop the pair for good
+			Kill = 0,
+			//keep the pair in the broadphase but without any contacts
+			Suppress = (1 << 0),
+			//generate and solve contacts
+			Contact = (1 << 1),
+			//report the first touch to the simulation event callback (cheapest report)
+			ReportTouch = (1 << 2),
+			//report when the contact force goes over the contact report threshold of one of the actors
+			ReportForce = (1 << 3),
+			//report the first touch with all contact points (most expensive report)
+			ReportPoints = (1 << 4),
+			//pass trigger events (one of the shapes is a trigger)
+			Trigger = (1 << 5),
+			//sweep the pair if one of the actors has CCD switched on (see FilterFlag::CCD)
+			CCD = (1 << 6)
+		};
+	};
+
+	///Index of the group bit stored in word0 of the filter data (32 for no group)
+	constexpr PxU32 FilterGroupIndex(PxU32 bits, PxU32 index = 0)
+	{
+		return ((index == 32) || (bits & 1)) ? index : FilterGroupIndex(bits >> 1, index + 1);
+	}
+
+	///Filter shader generated from a table of pair policies
+	///Table::Count is the number of groups and Table::Policy(group0, group1) the PairPolicy of two group indices,
+	///shapes without a group use the group with index 0
+	template<typename Table>
+	PxFilterFlags TableFilterShader(PxFilterObjectAttributes attributes0, PxFilterData filterData0,
+		PxFilterObjectAttributes attributes1, PxFilterData filterData1,
+		PxPairFlags& pairFlags, const void* constantBlock, PxU32 constantBlockSize)
+	{
+		PxU32 group0 = FilterGroupIndex(filterData0.word0);
+		PxU32 group1 = FilterGroupIndex(filterData1.word0);
+		PxU32 policy = Table::Policy((group0 < Table::Count) ? group0 : 0, (group1 < Table::Count) ? group1 : 0);
+
+		if (policy == PairPolicy::Kill)
+			return PxFilterFlag::eKILL;
+
+		if (PxFilterObjectIsTrigger(attributes0) || PxFilterObjectIsTrigger(attributes1))
+		{
+			if (!(policy & PairPolicy::Trigger))
+				return PxFilterFlag::eKILL;
+
+			pairFlags = PxPairFlag::eTRIGGER_DEFAULT;
+			return PxFilterFlags();
+		}
+
+		if (!(policy & PairPolicy::Contact))
+			return PxFilterFlag::eSUPPRESS;
+
+		pairFlags = PxPairFlag::eCONTACT_DEFAULT;
+
+		if (policy & (PairPolicy::ReportTouch | PairPolicy::ReportPoints))
+			pairFlags |= PxPairFlag::eNOTIFY_TOUCH_FOUND;
+
+		if (policy & PairPolicy::ReportPoints)
+			pairFlags |= PxPairFlag::eNOTIFY_CONTACT_POINTS;
+
+		if (policy & PairPolicy::ReportForce)
+			pairFlags |= PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND;
+
+		if ((policy & PairPolicy::CCD) && ((filterData0.word3 | filterData1.word3) & FilterFlag::CCD))
+			pairFlags |= PxPairFlag::eCCD_LINEAR;
+
+		return PxFilterFlags();
+	}
+
 	///Abstract Actor class
 	///Inherit from this class to create your own actors
 	class Actor
 	{
 	protected:
 		PxActor* actor;
-		std::vector<PxVec3> colors;
 		std::string name;
 
 	public:
@@ -47,11 +173,13 @@ namespace PhysicsEngine
 		{
 		}
 
+		virtual ~Actor() {}
+
 		PxActor* Get();
 
 		void Color(PxVec3 new_color, PxU32 shape_index=-1);
 
-		const PxVec3* Color(PxU32 shape_indx=0);
+		PxVec3 Color(PxU32 shape_indx=0);
 
 		void Actor::Name(const string& name);
 
@@ -70,6 +198,25 @@ namespace PhysicsEngine
 		void SetupFiltering(PxU32 filterGroup, PxU32 filterMask, PxU32 shape_index=-1);
 	};
 
+	///Solver settings for a group of similar actors
+	struct SolverProfile
+	{
+		//solver iterations (PhysX default: 4 position, 1 velocity)
+		PxU32 position_iterations;
+		PxU32 velocity_iterations;
+		//limit of the velocity used to push overlapping bodies apart
+		PxReal max_depenetration_velocity;
+		//mass-normalised kinetic energy below which the actor can go to sleep (PhysX default: 0.005)
+		PxReal sleep_threshold;
+		//mass-normalised kinetic energy below which the actor is stabilised (PhysX default: 0.001)
+		PxReal stabilization_threshold;
+	};
+
+	///Simple bodies without joints: the puck, the players
+	static const SolverProfile solver_light = { 2, 1, 10.f, .005f, .01f };
+	///Bodies held by springs or driven joints: the trampoline, the flipper, the motor arms
+	static const SolverProfile solver_jointed = { 12, 4, 10.f, .005f, .01f };
+
 	class DynamicActor : public Actor
 	{
 	public:
@@ -80,6 +227,30 @@ namespace PhysicsEngine
 		void CreateShape(const PxGeometry& geometry, PxReal density);
 
 		void SetKinematic(bool value, PxU32 index=-1);
+
+		///Set the mass-normalised kinetic energy below which the actor can go to sleep
+		void SleepThreshold(PxReal value);
+
+		PxReal SleepThreshold();
+
+		///Set the time (in seconds) the actor stays awake before it can go to sleep
+		void WakeCounter(PxReal value);
+
+		PxReal WakeCounter();
+
+		///Apply solver iterations, depenetration limit and thresholds from a profile
+		void Solver(const SolverProfile& profile);
+
+		///Enable continuous collision detection for fast moving actors
+		///(needs the CCD pair flag set by the filter shader, see FilterFlag::CCD)
+		void SetCCD(bool value);
+
+		bool CCD();
+
+		///Contact force above which the pairs with PairPolicy::ReportForce are reported (PX_MAX_F32 - never)
+		void ContactReportThreshold(PxReal value);
+
+		PxReal ContactReportThreshold();
 	};
 
 	class StaticActor : public Actor
@@ -90,6 +261,31 @@ namespace PhysicsEngine
 		~StaticActor();
 
 		void CreateShape(const PxGeometry& geometry, PxReal density=0.f);
+
+		///Move the static actor (use this rather than setGlobalPose, so that the renderer re-bakes the statics)
+		void Pose(const PxTransform& pose);
+	};
+
+	///A group of actors that enters the broadphase as a single object
+	///Use it for multi-part props whose parts never need to collide with each other
+	class Aggregate
+	{
+		PxAggregate* aggregate;
+		std::vector<Actor*> actors;
+
+	public:
+		///max_actors: capacity of the group, self_collision: collide the grouped actors with each other
+		Aggregate(PxU32 max_actors, bool self_collision=false);
+
+		///Release the group (the actors are not released)
+		~Aggregate();
+
+		///Add an actor to the group (before the group is added to the scene)
+		void Add(Actor* actor);
+
+		PxAggregate* Get();
+
+		const std::vector<Actor*>& Actors();
 	};
 
 	///Generic scene class
@@ -98,40 +294,125 @@ namespace PhysicsEngine
 	protected:
 		//a PhysX scene object
 		PxScene* px_scene;
+		//task dispatcher owned by this scene and the number of its worker threads
+		PxDefaultCpuDispatcher* cpu_dispatcher;
+		PxU32 worker_threads;
 		//pause simulation
 		bool pause;
 		//selected dynamic actor on the scene
 		PxRigidDynamic* selected_actor;
-		//original and modified colour of the selected actor
-		std::vector<PxVec3> sactor_color_orig;
 		//custom filter shader
 		PxSimulationFilterShader filter_shader;
+		//incremented whenever a static actor is added or removed
+		PxU32 static_revision;
+		//dynamic actors currently asleep (kept up to date by OnSleep/OnWake)
+		std::unordered_set<PxActor*> sleeping_actors;
+		//fast actors checked by the substepping policy
+		std::vector<PxRigidDynamic*> fast_actors;
+		//thickness of the thinnest collider added to the scene
+		PxReal thinnest_collider;
+		//largest fraction of the thinnest collider a fast actor can travel in one substep
+		PxReal substep_fraction;
+		PxU32 max_substeps;
+		//speed of the fastest tracked actor after the last update, decides the substeps of the next one
+		PxReal fast_speed;
+		//time step of the current update
+		PxReal time_step;
+		//generate the debug render buffer
+		bool visualisation;
+
+		void UpdateThinnestCollider(Actor* actor);
+
+		void SetSleeping(PxActor* actor, bool value);
 
 		void HighlightOn(PxRigidDynamic* actor);
 
 		void HighlightOff(PxRigidDynamic* actor);
 
 	public:
-		Scene(PxSimulationFilterShader custom_filter_shader=PxDefaultSimulationFilterShader) : filter_shader(custom_filter_shader) {}
+		Scene(PxSimulationFilterShader custom_filter_shader=PxDefaultSimulationFilterShader) : px_scene(0), cpu_dispatcher(0), worker_threads(1), filter_shader(custom_filter_shader), static_revision(0),
+			thinnest_collider(PX_MAX_F32), substep_fraction(.5f), max_substeps(4), fast_speed(0.f), time_step(0.f), visualisation(false) {}
+
+		virtual ~Scene() {}
 
 		///Init the scene
 		void Init();
 
+		///Release what CustomInit created, the PhysX scene and its dispatcher
+		void Release();
+
+		///Set the number of worker threads used to simulate this scene (call before Init)
+		///0 runs the simulation tasks on the thread calling Update
+		void WorkerThreads(PxU32 value);
+
 		///User defined initialisation
 		virtual void CustomInit() {}
 
 		///Perform a single simulation step
+		///the step is split into substeps when a fast actor would travel too far in one go
 		void Update(PxReal dt);
 
-		///User defined update step
+		///Let the substepping policy watch the speed of this actor
+		///(actors with CCD are already swept and are ignored, so substepping only guards non-CCD bodies)
+		void AddFastActor(Actor* actor);
+
+		///Configure the substepping policy:
+		// - fraction: largest part of the thinnest collider a fast actor can travel per substep
+		// - max: upper limit of substeps per update (1 disables substepping)
+		void SubstepPolicy(PxReal fraction, PxU32 max);
+
+		///Release the objects created by CustomInit, called before the PhysX scene is released (by Release and Reset)
+		virtual void CustomRelease() {}
+
+		///User defined update step, called once per Update
 		virtual void CustomUpdate() {}
 
+		///User defined substep, called before every simulate of an Update (TimeStep is the substep length)
+		///Forces added with addForce only last for one simulate, so continuous forces are added here
+		virtual void CustomSubstep() {}
+
+		///Time step of the current update (e.g. for CustomUpdate) or substep (for CustomSubstep)
+		PxReal TimeStep();
+
 		///Add actors
 		void Add(Actor* actor);
 
+		///Add a group of actors
+		void Add(Aggregate* aggregate);
+
+		///Remove actors
+		void Remove(Actor* actor);
+
+		///Drop what the scene keeps about an actor (sleeping, fast), called by the actor destructors
+		///so that an actor released without Remove leaves no dangling pointers behind
+		void Forget(Actor* actor);
+
+		///Get the revision of the static actor set (changes when statics are added, removed, moved or recoloured)
+		PxU32 StaticRevision();
+
+		///Switch the generation of debug visualisation on/off (off by default, kept after Reset)
+		void Visualisation(bool value);
+
+		bool Visualisation();
+
+		///Limit the debug visualisation to the actors inside this box
+		void VisualisationCullingBox(const PxBounds3& box);
+
 		///Get the PxScene object
 		PxScene* Get();
 
+		///Called from the simulation event callback when actors go to sleep
+		void OnSleep(PxActor** actors, PxU32 count);
+
+		///Called from the simulation event callback when actors wake up
+		void OnWake(PxActor** actors, PxU32 count);
+
+		///Check if the actor is asleep
+		bool IsSleeping(PxActor* actor);
+
+		///Number of sleeping dynamic actors
+		PxU32 SleepingCount();
+
 		///Reset the scene
 		void Reset();
 
@@ -155,6 +436,42 @@ namespace PhysicsEngine
 		std::vector<PxActor*> GetAllActors();
 	};
 
+	///A fixed set of dynamic actors made up front from one prototype
+	///Spawning adds a free actor back to the scene with a fresh state and despawning removes it,
+	///so nothing is created or released while the game is running
+	///Scene::Reset drops the spawned actors with the old PhysX scene: call DespawnAll afterwards to return them to the pool
+	class ActorPool
+	{
+		Scene* scene;
+		std::vector<DynamicActor*> actors;
+		std::vector<DynamicActor*> free_actors;
+		std::vector<bool> spawned;
+		bool fast;
+
+	public:
+		///Create size actors with the prototype function (the pool owns them)
+		///fast - register spawned actors for the velocity-adaptive substepping of the scene
+		ActorPool(Scene* scene, PxU32 size, const std::function<DynamicActor*()>& prototype, bool fast=false);
+
+		///Remove the spawned actors from the scene and release all actors
+		~ActorPool();
+
+		///Add a free actor to the scene at pose, returns 0 if all actors are spawned
+		DynamicActor* Spawn(const PxTransform& pose, const PxVec3& velocity=PxVec3(0.f));
+
+		///Remove a spawned actor from the scene and return it to the pool
+		void Despawn(DynamicActor* actor);
+
+		///Despawn all spawned actors
+		void DespawnAll();
+
+		///Number of actors that can still be spawned
+		PxU32 Free();
+
+		///Number of actors in the pool
+		PxU32 Size();
+	};
+
 	///Generic Joint class
 	class Joint
 	{
@@ -164,6 +481,12 @@ namespace PhysicsEngine
 	public:
 		Joint() : joint(0) {}
 
+		virtual ~Joint()
+		{
+			if (joint)
+				joint->release();
+		}
+
 		PxJoint* Get() { return joint; }
 	};
 
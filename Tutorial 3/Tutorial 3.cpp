@@ -1,10 +1,87 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "VisualDebugger.h"
+#include "Benchmarks.h"
+#include "MatchRunner.h"
 
 using namespace std;
+using namespace physx;
 
-int main()
+///Parse a comma separated list of visual debugger flags: debug, profile, memory
+PxVisualDebuggerConnectionFlags ParsePvdFlags(const string& list)
 {
+	PxVisualDebuggerConnectionFlags flags;
+	if (list.find("debug") != string::npos)
+		flags |= PxVisualDebuggerConnectionFlag::eDEBUG;
+	if (list.find("profile") != string::npos)
+		flags |= PxVisualDebuggerConnectionFlag::ePROFILE;
+	if (list.find("memory") != string::npos)
+		flags |= PxVisualDebuggerConnectionFlag::eMEMORY;
+	return flags;
+}
+
+///Value of a "-name value" command line option, 0 if not given
+const char* Option(int argc, char** argv, const char* name)
+{
+	for (int i = 1; i < (argc - 1); i++)
+		if (!strcmp(argv[i], name))
+			return argv[i+1];
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	//the visual debugger is off unless one of these is given:
+	// "-pvd <host>" streams to a running visual debugger
+	// "-pvdfile <file>" captures into a file
+	// "-pvdflags <debug,profile,memory>" selects what is sent
+	PhysicsEngine::PvdConfig pvd;
+	if (Option(argc, argv, "-pvd"))
+	{
+		pvd.mode = PhysicsEngine::PvdConfig::eSOCKET;
+		pvd.host = Option(argc, argv, "-pvd");
+	}
+	if (Option(argc, argv, "-pvdfile"))
+	{
+		pvd.mode = PhysicsEngine::PvdConfig::eFILE;
+		pvd.file = Option(argc, argv, "-pvdfile");
+	}
+	if (Option(argc, argv, "-pvdflags"))
+		pvd.flags = ParsePvdFlags(Option(argc, argv, "-pvdflags"));
+	PhysicsEngine::PvdSettings(pvd);
+
+	//"-benchmark <name>" runs a benchmark without opening the window
+	if (Option(argc, argv, "-benchmark"))
+	{
+		try
+		{
+			if (!Benchmarks::Run(Option(argc, argv, "-benchmark")))
+				cerr << "Unknown benchmark: " << Option(argc, argv, "-benchmark") << endl;
+		}
+		catch (Exception exc)
+		{
+			cerr << exc.what() << endl;
+		}
+		return 0;
+	}
+
+	//"-matches <count>" plays bot matches in parallel and reports the throughput
+	if (Option(argc, argv, "-matches"))
+	{
+		try
+		{
+			PhysicsEngine::PxInit();
+			MatchRunner::Report(atoi(Option(argc, argv, "-matches")));
+			PhysicsEngine::PxRelease();
+		}
+		catch (Exception exc)
+		{
+			cerr << exc.what() << endl;
+		}
+		return 0;
+	}
+
 	try 
 	{ 
 		VisualDebugger::Init("Tutorial 3", 800, 800); 
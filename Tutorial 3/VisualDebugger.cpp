@@ -3,6 +3,8 @@
 #include "Extras\Camera.h"
 #include "Extras\Renderer.h"
 #include "Extras\HUD.h"
+#include "Extras\InputQueue.h"
+#include <chrono>
 
 namespace VisualDebugger
 {
@@ -31,7 +33,6 @@ namespace VisualDebugger
 	};
 
 	//function declarations
-	void KeyHold();
 	void KeySpecial(int key, int x, int y);
 	void KeyRelease(unsigned char key, int x, int y);
 	void KeyPress(unsigned char key, int x, int y);
@@ -41,6 +42,8 @@ namespace VisualDebugger
 	void exitCallback(void);
 
 	void RenderScene();
+	void Simulate();
+	double Now();
 	void ToggleRenderMode();
 	void HUDInit();
 	void cameraMove(enum cameraPlacement);
@@ -51,11 +54,25 @@ namespace VisualDebugger
 	PxReal delta_time = 1.f / 120.f;
 	PxReal gForceStrength = 200;
 	RenderMode render_mode = NORMAL;
+	//debug geometry is generated only this far in front of the camera
+	PxReal debug_range = 150.f;
+	//revision of the static actors currently baked into the renderer
+	PxU32 static_revision = (PxU32)-1;
 
 	const int MAX_KEYS = 256;
 	bool key_state[MAX_KEYS];
 
+	//movement actions waiting for their simulation step
+	InputQueue input;
+	//push of each player during the current step
+	vector<PxVec3> player_push(2);
+	//time the next simulation step starts at
+	double step_time;
+	//limit of steps taken in a single frame
+	const PxU32 max_steps_per_frame = 8;
+
 	bool hud_show = true;
+	bool profile_show = false;
 	HUD hud;
 	int score1 = 0, score2 = 0;
 	bool gameOver, direction;
@@ -110,9 +127,12 @@ namespace VisualDebugger
 		int direction2 = (rand() % 2) - 1;
 		if (firstActor == "Ball")
 		{
-			scene->GetSelectedActor()->addForce(PxVec3(direction1, 0, direction2)*gForceStrength);
+			scene->GetSelectedActor()->addForce(PxVec3(direction1, 0, direction2)*gForceStrength*delta_time, PxForceMode::eIMPULSE);
 		}
 
+		//the simulation clock starts now
+		step_time = Now();
+
 	}
 
 	void HUDInit()
@@ -134,6 +154,7 @@ namespace VisualDebugger
 		hud.AddLine(EMPTY, "    F12 - reset");
 		hud.AddLine(EMPTY, "");
 		hud.AddLine(EMPTY, " Display");
+		hud.AddLine(EMPTY, "    F4 - profiler on/off");
 		hud.AddLine(EMPTY, "    F5 - help on/off");
 		hud.AddLine(EMPTY, "    F6 - shadows on/off");
 		hud.AddLine(EMPTY, "    F7 - render mode");
@@ -151,6 +172,15 @@ namespace VisualDebugger
 		hud.AddLine(HELP, "");
 		hud.AddLine(HELP, "F6 - Toggle Shadows, F9 - New Game");
 		hud.AddLine(HELP, "F10 - Pause Game, F11 - Reset positions");
+		if (profile_show)
+		{
+			const Renderer::RenderStats& stats = Renderer::GetRenderStats();
+			hud.AddLine(HELP, "");
+			hud.AddLine(HELP, "Shapes drawn: " + std::to_string(stats.shapes_total - stats.shapes_culled) + 
+				", culled: " + std::to_string(stats.shapes_culled));
+			hud.AddLine(HELP, "Sleeping actors: " + std::to_string(scene->SleepingCount()) + 
+				", cached shapes: " + std::to_string(stats.shapes_sleeping));
+		}
 		//add a pause screen
 		hud.AddLine(PAUSE, "   Simulation paused. Press F10 to continue.");
 
@@ -196,22 +226,31 @@ namespace VisualDebugger
 	//Render the scene and perform a single simulation step
 	void RenderScene()
 	{
-		//handle pressed keys
-		KeyHold();
-
 		//start rendering
 		Renderer::Start(camera->getEye(), camera->getDir());
 
 		if ((render_mode == DEBUG) || (render_mode == BOTH))
 		{
 			Renderer::Render(scene->Get()->getRenderBuffer());
+
+			//limit the next buffer to the actors around the view
+			scene->VisualisationCullingBox(PxBounds3::centerExtents(camera->getEye() + camera->getDir()*debug_range*.5f, 
+				PxVec3(debug_range*.5f)));
 		}
 
 		if ((render_mode == NORMAL) || (render_mode == BOTH))
 		{
 			std::vector<PxActor*> actors = scene->GetAllActors();
 			if (actors.size())
+			{
+				//re-bake the static geometry only when statics were added, removed, moved or recoloured
+				if (scene->StaticRevision() != static_revision)
+				{
+					Renderer::BuildStaticBatch(&actors[0], (PxU32)actors.size());
+					static_revision = scene->StaticRevision();
+				}
 				Renderer::Render(&actors[0], (PxU32)actors.size());
+			}
 		}
 
 		//adjust the HUD state
@@ -236,18 +275,14 @@ namespace VisualDebugger
 		//finish rendering
 		Renderer::Finish();
 
-		//set forces to obstacle dpendant on what direction the object should be heading
-		if (scene->direction == true)
-		{
-			scene->GetPlayer("Obstacle")->addForce(PxVec3(0.f, 0.f, 1.f)*gForceStrength / 10);
-		}
-		else if (scene->direction == false)
-		{
-			scene->GetPlayer("Obstacle")->addForce(PxVec3(0.f, 0.f, -1.f)*gForceStrength / 10);
-		}
+		//perform the simulation steps due by now
+		Simulate();
+	}
 
-		//perform a single simulation step
-		scene->Update(delta_time);
+	//time in seconds
+	double Now()
+	{
+		return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
 	//user defined keyboard handlers
@@ -293,149 +328,73 @@ namespace VisualDebugger
 		}
 	}
 
-	void UserKeyHold(int key)
+	//movement keys: player, push in the overhead view and push in the first person views
+	struct MovementKey
 	{
-	}
+		int key;
+		int player;
+		PxVec3 overhead, first_person;
+	};
 
-	//obsolete function due to change/removal of camera control
-	void CameraInput(int key)
+	static const MovementKey movement_keys[] = {
+		//right hand side player
+		{ 54, 0, PxVec3(1, 0, 0), PxVec3(0, 0, -1) },	//KEYPAD 6
+		{ 52, 0, PxVec3(-1, 0, 0), PxVec3(0, 0, 1) },	//KEYPAD 4
+		{ 56, 0, PxVec3(0, 0, -1), PxVec3(-1, 0, 0) },	//KEYPAD 8
+		{ 53, 0, PxVec3(0, 0, 1), PxVec3(1, 0, 0) },	//KEYPAD 5
+		//left hand side player
+		{ 119, 1, PxVec3(0, 0, -1), PxVec3(1, 0, 0) },	//W
+		{ 115, 1, PxVec3(0, 0, 1), PxVec3(-1, 0, 0) },	//S
+		{ 97, 1, PxVec3(-1, 0, 0), PxVec3(0, 0, -1) },	//A
+		{ 100, 1, PxVec3(1, 0, 0), PxVec3(0, 0, 1) } };	//D
+
+	//turn a movement key event into a timestamped action, false for other keys
+	bool MovementAction(int key, bool pressed, InputAction& action)
 	{
-		switch (toupper(key))
+		for (const MovementKey& movement : movement_keys)
 		{
-		case 'I':
-			camera->MoveForward(delta_time);
-			break;
-		case 'K':
-			camera->MoveBackward(delta_time);
-			break;
-		case 'J':
-			camera->MoveLeft(delta_time);
-			break;
-		case 'L':
-			camera->MoveRight(delta_time);
-			break;
-		case 'Q':
-			camera->MoveUp(delta_time);
-			break;
-		case 'Z':
-			camera->MoveDown(delta_time);
-			break;
-		default:
-			break;
+			if (movement.key == key)
+			{
+				action.time = Now();
+				action.key = key;
+				action.player = movement.player;
+				//the axes follow the camera at the time of the key press
+				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
+					action.direction = movement.first_person;
+				else
+					action.direction = movement.overhead;
+				action.pressed = pressed;
+				return true;
+			}
 		}
+		return false;
 	}
 
-	//handle force control keys
-	void ForceInput(int key)
+	//run the fixed simulation steps that fall into the time elapsed since the last frame
+	void Simulate()
 	{
-		string playerChoice1, playerChoice2;
+		double now = Now();
+
+		//drop the steps that can't be caught up with (e.g. after dragging the window)
+		if ((now - step_time) > (max_steps_per_frame*delta_time))
+			step_time = now - max_steps_per_frame*delta_time;
 
-		if (score1 < 5 && score2 < 5)
+		while ((now - step_time) >= delta_time)
 		{
-			switch (key)
+			//hand the input that happened during this step to the player controllers
+			input.Step(step_time, step_time + delta_time, player_push);
+			//a paused scene doesn't take the pushes, they would pile up until it continues
+			if (score1 < 5 && score2 < 5 && !scene->Pause())
 			{
-				//right hand side player (actually player 2)
-			case 54: //KEYPAD 6
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(0, 0, -1)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(1, 0, 0)*gForceStrength);
-				}
-				break;
-				//move left
-			case 52: //KEYPAD 4
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(0, 0, 1)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(-1, 0, 0)*gForceStrength);
-				}
-				break;
-				//down
-			case 56:
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(-1, 0, 0)*gForceStrength); // KEYPAD 8 - forward
-				}
-				else
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(0, 0, -1)*gForceStrength);
-				}
-				break;
-				//up
-			case 53: // KEYPAD 5
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(1, 0, 0)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 1")->addForce(PxVec3(0, 0, 1)*gForceStrength);
-				}
-				break;
-
-				/*-----------------Player 1 (left hand side player)-----------------*/
-				// Force controls on the selected actor
-			case 119: //forward
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(1, 0, 0)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(0, 0, -1)*gForceStrength);
-				}
-				break;
-			case 115: //backward
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(-1, 0, 0)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(0, 0, 1)*gForceStrength);
-				}
-				break;
-			case 97: //left
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(0, 0, -1)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(-1, 0, 0)*gForceStrength);
-				}
-				break;
-			case 100: //right
-				//change movement axis dependant on whether the camera is first person view or not
-				if (cameraState == cameraPlacement::PLAYER1 || cameraState == cameraPlacement::PLAYER2)
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(0, 0, 1)*gForceStrength);
-				}
-				else
-				{
-					scene->GetPlayer("Player 2")->addForce(PxVec3(1, 0, 0)*gForceStrength);
-				}
-				break;
-			default:
-				break;
+				for (unsigned int i = 0; i < player_push.size(); i++)
+					scene->controllers[i]->Push(player_push[i]);
 			}
+
+			scene->Update(delta_time);
+			step_time += delta_time;
 		}
 	}
 
-
 	///handle special keys
 	void KeySpecial(int key, int x, int y)
 	{
@@ -444,6 +403,10 @@ namespace VisualDebugger
 		switch (key)
 		{
 			//display control
+		case GLUT_KEY_F4:
+			//profiler on/off
+			profile_show = !profile_show;
+			break;
 		case GLUT_KEY_F5:
 			//hud on/off
 			hud_show = !hud_show;
@@ -454,7 +417,7 @@ namespace VisualDebugger
 			break;
 		case GLUT_KEY_F7:
 			//toggle render mode
-			//ToggleRenderMode();
+			ToggleRenderMode();
 			break;
 		case GLUT_KEY_F8:
 			//reset camera view
@@ -467,6 +430,8 @@ namespace VisualDebugger
 			break;
 		case GLUT_KEY_F9:
 			scene->Reset();
+			//the meshes of the old scene may be released and their addresses reused
+			Renderer::ClearMeshCache();
 			//scene->newGame();
 			HUDInit();
 			break;
@@ -492,26 +457,23 @@ namespace VisualDebugger
 			exit(0);
 
 		UserKeyPress(key);
+
+		InputAction action;
+		if (MovementAction(key, true, action))
+			input.Push(action);
 	}
 
 	//handle key release
 	void KeyRelease(unsigned char key, int x, int y)
 	{
+		if (key_state[key] == false)
+			return;
+
 		key_state[key] = false;
-	}
 
-	//handle holded keys
-	void KeyHold()
-	{
-		for (int i = 0; i < MAX_KEYS; i++)
-		{
-			if (key_state[i]) // if key down
-			{
-				CameraInput(i);
-				ForceInput(i);
-				UserKeyHold(i);
-			}
-		}
+		InputAction action;
+		if (MovementAction(key, false, action))
+			input.Push(action);
 	}
 
 	///mouse handling
@@ -543,13 +505,18 @@ namespace VisualDebugger
 			render_mode = BOTH;
 		else if (render_mode == BOTH)
 			render_mode = NORMAL;
+
+		//PhysX fills the debug buffer only when it is drawn
+		scene->Visualisation((render_mode == DEBUG) || (render_mode == BOTH));
 	}
 
 	///exit callback
 	void exitCallback(void)
 	{
 		delete camera;
+		scene->Release();
 		delete scene;
+		Renderer::Release();
 		PhysicsEngine::PxRelease();
 	}
 }